@@ -33,6 +33,8 @@ const GBenchmark::Factory gBenchFactories[] {
     []() -> GBenchmark* { return new PolyRectsBench(true);  },
     []() -> GBenchmark* { return new CirclesBench(false); },
     []() -> GBenchmark* { return new CirclesBench(true);  },
+    []() -> GBenchmark* { return new OvalsBench(false); },
+    []() -> GBenchmark* { return new OvalsBench(true);  },
     []() -> GBenchmark* { return new ModesBench({1, 0.5, 0.25, 0.0}, "modes_0"); },
     []() -> GBenchmark* { return new ModesBench({1, 0.5, 0.25, 0.5}, "modes_x"); },
     []() -> GBenchmark* { return new ModesBench({1, 0.5, 0.25, 1.0}, "modes_1"); },
@@ -40,6 +42,24 @@ const GBenchmark::Factory gBenchFactories[] {
     // pa3
     []() -> GBenchmark* { return new BitmapBench("apps/spock.png", "bitmap_opaque"); },
     []() -> GBenchmark* { return new BitmapBench("apps/wheel.png", "bitmap_alpha"); },
+    []() -> GBenchmark* { return new BitmapMatrixBench("apps/spock.png", "bitmap_offset",
+                                                       GMatrix::Translate(-37, 12)); },
+    []() -> GBenchmark* { return new BitmapMatrixBench("apps/spock.png", "bitmap_rotate",
+                                                       GMatrix::Translate(100, -40) * GMatrix::Rotate(0.6f)); },
+    []() -> GBenchmark* { return new BitmapMatrixBench("apps/spock.png", "bitmap_rotate_tiled",
+                                                       GMatrix::Translate(100, -40) * GMatrix::Rotate(0.6f),
+                                                       GMipmapMode::kNone, GTextureLayout::kTiled); },
+    []() -> GBenchmark* { return new BitmapMatrixBench("apps/wood4.png", "bitmap_rotate_steep",
+                                                       GMatrix::Translate(150, -60) * GMatrix::Rotate(1.4f)); },
+    []() -> GBenchmark* { return new BitmapMatrixBench("apps/wood4.png", "bitmap_rotate_steep_tiled",
+                                                       GMatrix::Translate(150, -60) * GMatrix::Rotate(1.4f),
+                                                       GMipmapMode::kNone, GTextureLayout::kTiled); },
+    []() -> GBenchmark* { return new BitmapMatrixBench("apps/wood4.png", "bitmap_shrink",
+                                                       GMatrix::Rotate(0.2f) * GMatrix::Scale(0.04f, 0.04f)); },
+    []() -> GBenchmark* { return new BitmapMatrixBench("apps/wood4.png", "bitmap_shrink_mip",
+                                                       GMatrix::Rotate(0.2f) * GMatrix::Scale(0.04f, 0.04f),
+                                                       GMipmapMode::kNearest); },
+    []() -> GBenchmark* { return new PngDecodeBench("apps/wood4.png", "png_decode"); },
 
     // pa4
     []() -> GBenchmark* {
@@ -54,6 +74,14 @@ const GBenchmark::Factory gBenchFactories[] {
         const GColor colors[] = {{ 1, 0, 0, 1 }, { 0, 1, 1, 1 }, {0, 1, 0, 0}};
         return new GradientBench(colors, 3, "gradient_3");
     },
+    []() -> GBenchmark* {
+        const GColor colors[] = {{ 1, 0, 0, 1 }, { 0, 1, 1, 1 }};
+        return new GradientBench(colors, 2, "gradient_horizontal", GTileMode::kClamp, {200, 0});
+    },
+    []() -> GBenchmark* {
+        const GColor colors[] = {{ 1, 0, 0, 1 }, { 0, 1, 1, 1 }};
+        return new GradientBench(colors, 2, "gradient_vertical", GTileMode::kClamp, {0, 200});
+    },
     []() -> GBenchmark* { return new PathBench("path_small", 0.1f, false); },
     []() -> GBenchmark* { return new PathBench("path_big",   1.0f, false); },
     []() -> GBenchmark* { return new PathBench("path_bigc",  1.0f,  true); },
@@ -101,6 +129,8 @@ const GBenchmark::Factory gBenchFactories[] {
         const GPoint texs[] = {{0, 0}, {100, 0}, {100, 100}, {0, 100}};
         return new QuadBench(colors, texs, "quad_mesh");
     },
+    []() -> GBenchmark* { return new MeshGridBench; },
+    []() -> GBenchmark* { return new MeshSliversBench; },
 
     nullptr,
 };
@@ -25,7 +25,7 @@ static std::unique_ptr<GShader> make_bm_shader(GBitmap bm, GMatrix localM) {
     return sh;
 }
 
-class CheckerShader : public GShader {
+class CheckerShader : public GSingleContextShader {
     const GMatrix fLocalMatrix;
     const GPixel fP0, fP1;
 
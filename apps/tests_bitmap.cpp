@@ -0,0 +1,343 @@
+/**
+ *  Copyright 2024 Aruj Bansal
+ */
+
+#include "../include/GArena.h"
+#include "../include/GCanvas.h"
+#include "../include/lodepng.h"
+#include "tests.h"
+#include "tests_utils.h"
+
+// The texel a sample at column or row v lands on in a side of n texels, worked out on its own
+static int tile(int v, int n, GTileMode mode) {
+    switch (mode) {
+        case GTileMode::kClamp:  return std::max(0, std::min(n - 1, v));
+        case GTileMode::kRepeat: return ((v % n) + n) % n;
+        case GTileMode::kMirror: {
+            int m = ((v % (2 * n)) + 2 * n) % (2 * n);
+            return m < n ? m : 2 * n - 1 - m;
+        }
+    }
+    return 0;
+}
+
+static void test_bitmap_sampling(GTestStats* stats) {
+    GBitmap bm;
+    bm.alloc(9, 6);
+    visit_pixels(bm, [](int x, int y, GPixel* p) { *p = GPixel_PackARGB(255, x * 20, y * 40, 0); });
+
+    // offsets, scales and rotations (chosen so no pixel center maps onto a texel edge) all sample like
+    // mapping each center on its own
+    const GMatrix matrices[] = {
+        GMatrix::Translate(-7.3f, 4.2f),
+        GMatrix::Translate(13.6f, -20.9f),
+        GMatrix::Translate(3.1f, 2.2f) * GMatrix::Scale(1.7f, 0.6f),
+        GMatrix::Translate(-2.1f, 5.3f) * GMatrix::Scale(0.37f, 2.9f),
+        GMatrix::Translate(4.1f, 1.3f) * GMatrix::Rotate(0.7f),
+    };
+
+    bool same = true;
+    for (GTileMode mode: {GTileMode::kClamp, GTileMode::kRepeat, GTileMode::kMirror}) {
+        for (const GMatrix& mx: matrices) {
+            auto shader = GCreateBitmapShader(bm, mx, mode);
+            GArena arena;
+            GShader::Context* ctx = shader->makeContext(GMatrix(), arena);
+            EXPECT_TRUE(stats, ctx != nullptr);
+            const GMatrix inv = mx.invert().value();
+
+            for (int y = -12; y < 30; y += 5) {
+                for (int x: {-40, -3, 0, 6}) {
+                    const int N = 70;
+                    GPixel row[N];
+                    ctx->shadeRow(x, y, N, row);
+
+                    for (int i = 0; i < N; i++) {
+                        GPoint p = inv * GPoint{x + i + 0.5f, y + 0.5f};
+                        GPixel want = *bm.getAddr(tile(GFloorToInt(p.x), bm.width(), mode),
+                                                  tile(GFloorToInt(p.y), bm.height(), mode));
+                        same &= row[i] == want;
+                    }
+                }
+            }
+        }
+    }
+    EXPECT_TRUE(stats, same);
+
+    free(bm.pixels());
+}
+
+static void test_tile_stepping(GTestStats* stats) {
+    GBitmap bm;
+    bm.alloc(3, 2);
+    visit_pixels(bm, [](int x, int y, GPixel* p) { *p = GPixel_PackARGB(255, x * 100, y * 200, 0); });
+
+    // rotations whose steps cross several periods of a tiny bitmap at once, far from the origin in both directions;
+    // fixed point stepping may land a center that sits right on a texel edge on its neighbor, so allow a few
+    const GMatrix matrices[] = {
+        GMatrix::Rotate(0.4f) * GMatrix::Scale(0.13f, 0.21f),
+        GMatrix::Translate(-5.3f, 2.7f) * GMatrix::Rotate(-2.2f) * GMatrix::Scale(0.7f, 0.45f),
+        GMatrix::Rotate(1.1f) * GMatrix::Scale(3.3f, 1.9f),
+    };
+
+    int pixels = 0, different = 0;
+    for (GTileMode mode: {GTileMode::kClamp, GTileMode::kRepeat, GTileMode::kMirror}) {
+        for (const GMatrix& mx: matrices) {
+            auto shader = GCreateBitmapShader(bm, mx, mode);
+            GArena arena;
+            GShader::Context* ctx = shader->makeContext(GMatrix(), arena);
+            EXPECT_TRUE(stats, ctx != nullptr);
+            const GMatrix inv = mx.invert().value();
+
+            for (int y: {-1500, -37, 0, 11, 900}) {
+                for (int x: {-2000, -90, 4, 1200}) {
+                    const int N = 150;
+                    GPixel row[N];
+                    ctx->shadeRow(x, y, N, row);
+
+                    for (int i = 0; i < N; i++) {
+                        GPoint p = inv * GPoint{x + i + 0.5f, y + 0.5f};
+                        GPixel want = *bm.getAddr(tile(GFloorToInt(p.x), bm.width(), mode),
+                                                  tile(GFloorToInt(p.y), bm.height(), mode));
+                        pixels += 1;
+                        different += row[i] != want;
+                    }
+                }
+            }
+        }
+    }
+    EXPECT_TRUE(stats, different * 200 < pixels);
+
+    free(bm.pixels());
+}
+
+static void test_texel_edges(GTestStats* stats) {
+    // each pixel holds its own column and row, so a shaded pixel says which texel it came from
+    GBitmap bm;
+    bm.alloc(8, 8);
+    visit_pixels(bm, [](int x, int y, GPixel* p) { *p = GPixel_PackARGB(255, x, y, 0); });
+
+    // local matrices whose inverse maps pixel centers to u = scale * (x + 0.5) + offset exactly, with many of them
+    // exactly on a texel edge
+    const struct {
+        GMatrix local;
+        float scale, offset;
+    } cases[] = {
+        {GMatrix::Translate(0.5f, 0.5f), 1, -0.5f},                                 // every center on an edge
+        {GMatrix::Translate(-2.5f, -2.5f), 1, 2.5f},                                // and between edges
+        {GMatrix::Scale(2, 2) * GMatrix::Translate(-0.75f, -0.75f), 0.5f, 0.75f},   // every other center
+        {GMatrix::Translate(0.5f, 0.5f) * GMatrix::Scale(0.5f, 0.5f), 2, -1},       // every center, skipping texels
+    };
+
+    // a center on the edge between two texels samples the one to its right (or below), whichever loop shades
+    // it and wherever its span starts
+    bool right = true;
+    for (GTileMode mode: {GTileMode::kClamp, GTileMode::kRepeat, GTileMode::kMirror}) {
+        for (const auto& c: cases) {
+            auto shader = GCreateBitmapShader(bm, c.local, mode);
+            GArena arena;
+            GShader::Context* ctx = shader->makeContext(GMatrix(), arena);
+            EXPECT_TRUE(stats, ctx != nullptr);
+
+            for (int y = 0; y < 8; y++) {
+                for (int x0: {-3, 0, 1, 2}) {
+                    const int N = 12;
+                    GPixel row[N];
+                    ctx->shadeRow(x0, y, N, row);
+
+                    float v = c.scale * (y + 0.5f) + c.offset;
+                    for (int i = 0; i < N; i++) {
+                        float u = c.scale * (x0 + i + 0.5f) + c.offset;
+                        if (u < 0 || u >= 8 || v < 0 || v >= 8) continue;
+
+                        right &= row[i] == *bm.getAddr((int) u, (int) v);
+                    }
+                }
+            }
+        }
+    }
+    EXPECT_TRUE(stats, right);
+
+    // scales that aren't exact in binary still place each center on its own, so a pixel that falls right by an
+    // edge picks the same texel whether its span starts there or far to its left
+    bool same = true;
+    for (float scale: {300 / 7.0f, 3 / 7.0f, 1.1f}) {
+        auto shader = GCreateBitmapShader(bm, GMatrix::Translate(0.3f, 0) * GMatrix::Scale(scale, scale));
+        GArena arena;
+        GShader::Context* ctx = shader->makeContext(GMatrix(), arena);
+        EXPECT_TRUE(stats, ctx != nullptr);
+
+        const int N = 400;
+        GPixel whole[N];
+        ctx->shadeRow(0, 3, N, whole);
+        for (int x = 0; x < N; x++) {
+            // a context of its own, so nothing shaded for the whole row is reused
+            GArena one_arena;
+            GPixel one = 0;
+            if (GShader::Context* one_ctx = shader->makeContext(GMatrix(), one_arena)) one_ctx->shadeRow(x, 3, 1, &one);
+            same &= one == whole[x];
+        }
+    }
+    EXPECT_TRUE(stats, same);
+
+    free(bm.pixels());
+}
+
+static void test_texture_layout(GTestStats* stats) {
+    // sides that don't fill whole blocks
+    GBitmap bm;
+    bm.alloc(37, 21);
+    visit_pixels(bm, [](int x, int y, GPixel* p) { *p = GPixel_PackARGB(255, x * 6, y * 12, (x * y) & 255); });
+
+    const GMatrix matrices[] = {
+        GMatrix::Translate(-7.3f, 4.2f),
+        GMatrix::Translate(3.1f, 2.2f) * GMatrix::Scale(1.7f, 0.6f),
+        GMatrix::Translate(4.1f, 1.3f) * GMatrix::Rotate(0.7f),
+        GMatrix::Translate(30, -8) * GMatrix::Rotate(1.4f) * GMatrix::Scale(0.2f, 0.3f),
+    };
+
+    // blocks only change where texels are kept, never which one is sampled
+    bool same = true;
+    for (GTileMode mode: {GTileMode::kClamp, GTileMode::kRepeat, GTileMode::kMirror}) {
+        for (const GMatrix& mx: matrices) {
+            auto rows = GCreateBitmapShader(bm, mx, mode, GMipmapMode::kNearest);
+            auto blocks = GCreateBitmapShader(bm, mx, mode, GMipmapMode::kNearest, GTextureLayout::kTiled);
+            GArena arena;
+            GShader::Context* rows_ctx = rows->makeContext(GMatrix(), arena);
+            GShader::Context* blocks_ctx = blocks->makeContext(GMatrix(), arena);
+            EXPECT_TRUE(stats, rows_ctx && blocks_ctx);
+
+            for (int y = -12; y < 40; y += 3) {
+                const int N = 90;
+                GPixel want[N], got[N];
+                rows_ctx->shadeRow(-20, y, N, want);
+                blocks_ctx->shadeRow(-20, y, N, got);
+                same &= std::equal(want, want + N, got);
+            }
+        }
+    }
+    EXPECT_TRUE(stats, same);
+
+    free(bm.pixels());
+}
+
+static void test_mipmaps(GTestStats* stats) {
+    // one pixel black and white checks, which any shrinking filter should turn gray
+    GBitmap checks;
+    checks.alloc(64, 48);
+    visit_pixels(checks, [](int x, int y, GPixel* p) {
+        *p = (x + y) & 1 ? GPixel_PackARGB(255, 255, 255, 255) : GPixel_PackARGB(255, 0, 0, 0);
+    });
+
+    GBitmap bm;
+    bm.alloc(8, 6);
+    auto canvas = GCreateCanvas(bm);
+
+    auto gray_pixels = [&](GMipmapMode mode, const GMatrix& mx) {
+        auto shader = GCreateBitmapShader(checks, mx, GTileMode::kClamp, mode);
+        canvas->drawRect(GRect::WH(8, 6), GPaint(shader.get()));
+
+        int gray = 0;
+        visit_pixels(bm, [&](int, int, GPixel* p) { gray += std::abs((int) GPixel_GetR(*p) - 128) <= 1; });
+        return gray;
+    };
+
+    const GMatrix eighth = GMatrix::Scale(1 / 8.0f, 1 / 8.0f);
+    EXPECT_EQ(stats, gray_pixels(GMipmapMode::kNone, eighth), 0);
+    EXPECT_EQ(stats, gray_pixels(GMipmapMode::kNearest, eighth), 48);
+    EXPECT_EQ(stats, gray_pixels(GMipmapMode::kNearest, GMatrix::Rotate(0.3f) * eighth), 48);
+    // drawn at full size the bitmap itself is sampled
+    EXPECT_EQ(stats, gray_pixels(GMipmapMode::kNearest, GMatrix()), 0);
+
+    // each halving is the rounded average of 2x2 premultiplied pixels; odd and single pixel sides still work
+    GBitmap small;
+    small.alloc(2, 1);
+    *small.getAddr(0, 0) = GPixel_PackARGB(200, 100, 0, 3);
+    *small.getAddr(1, 0) = GPixel_PackARGB(101, 0, 51, 100);
+    auto shader = GCreateBitmapShader(small, GMatrix::Scale(0.5f, 0.5f), GTileMode::kClamp, GMipmapMode::kNearest);
+    GArena arena;
+    GShader::Context* ctx = shader->makeContext(GMatrix(), arena);
+    EXPECT_TRUE(stats, ctx != nullptr);
+    GPixel px;
+    ctx->shadeRow(0, 0, 1, &px);
+    EXPECT_EQ(stats, px, GPixel_PackARGB(151, 50, 26, 52));
+
+    GBitmap odd;
+    odd.alloc(7, 3);
+    visit_pixels(odd, [](int x, int y, GPixel* p) { *p = GPixel_PackARGB(255, x * 30, y * 80, 0); });
+    auto odd_shader = GCreateBitmapShader(odd, GMatrix::Scale(0.1f, 0.1f), GTileMode::kRepeat, GMipmapMode::kNearest);
+    canvas->drawRect(GRect::WH(8, 6), GPaint(odd_shader.get()));
+    EXPECT_EQ(stats, count_pixels(bm), 48);
+
+    // a single pixel has no halvings to draw from, and a single column halves along its length only
+    for (int h: {1, 5}) {
+        GBitmap thin;
+        thin.alloc(1, h);
+        visit_pixels(thin, [](int, int y, GPixel* p) { *p = GPixel_PackARGB(255, 40, 90, 200 - y); });
+        auto thin_shader = GCreateBitmapShader(thin, GMatrix(), GTileMode::kRepeat, GMipmapMode::kNearest);
+
+        canvas->clear({0, 0, 0, 0});
+        canvas->save();
+        canvas->scale(0.1f, 0.1f);
+        canvas->drawRect(GRect::WH(80, 60), GPaint(thin_shader.get()));
+        canvas->restore();
+
+        int filled = 0;
+        visit_pixels(bm, [&](int, int, GPixel* p) {
+            filled += GPixel_GetR(*p) == 40 && GPixel_GetG(*p) == 90 && GPixel_GetB(*p) >= 196;
+        });
+        EXPECT_EQ(stats, filled, 48);
+        free(thin.pixels());
+    }
+
+    free(checks.pixels());
+    free(bm.pixels());
+    free(small.pixels());
+    free(odd.pixels());
+}
+
+static void test_read_png(GTestStats* stats) {
+    // every alpha against every color value, with the other channels scrambled
+    const int W = 256, H = 256;
+    std::vector<uint8_t> rgba(W * H * 4);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            uint8_t* p = &rgba[(y * W + x) * 4];
+            p[0] = x, p[1] = 255 - x, p[2] = x ^ 0x5A, p[3] = y;
+        }
+    }
+
+    unsigned char* png = nullptr;
+    size_t size = 0;
+    EXPECT_EQ(stats, lodepng_encode32(&png, &size, rgba.data(), W, H), 0u);
+
+    GBitmap bm;
+    EXPECT_TRUE(stats, bm.readFromMemory(png, size));
+    EXPECT_TRUE(stats, bm.width() == W && bm.height() == H && !bm.isOpaque());
+
+    auto premul = [](unsigned c, unsigned a) { return (c * a + 127) / 255; };
+    bool exact = true;
+    visit_pixels(bm, [&](int x, int y, GPixel* p) {
+        const uint8_t* c = &rgba[(y * W + x) * 4];
+        exact &= *p == GPixel_PackARGB(c[3], premul(c[0], c[3]), premul(c[1], c[3]), premul(c[2], c[3]));
+    });
+    EXPECT_TRUE(stats, exact);
+    free(bm.pixels());
+    free(png);
+
+    // a file reads the same as its bytes in memory
+    GBitmap from_file, from_memory;
+    unsigned char* data = nullptr;
+    EXPECT_EQ(stats, lodepng_load_file(&data, &size, "apps/spock.png"), 0u);
+    EXPECT_TRUE(stats, from_file.readFromFile("apps/spock.png") && from_memory.readFromMemory(data, size));
+    EXPECT_EQ(stats, max_channel_diff(from_file, from_memory), 0);
+    EXPECT_EQ(stats, from_file.isOpaque(), from_memory.isOpaque());
+    free(from_file.pixels());
+    free(from_memory.pixels());
+
+    // anything else fails, and leaves the bitmap empty
+    EXPECT_FALSE(stats, from_memory.readFromMemory(data, size / 2));
+    EXPECT_TRUE(stats, from_memory.pixels() == nullptr && from_memory.width() == 0);
+    EXPECT_FALSE(stats, from_file.readFromFile("apps/no_such_file.png"));
+    EXPECT_TRUE(stats, from_file.pixels() == nullptr);
+    free(data);
+}
@@ -0,0 +1,148 @@
+/**
+ *  Copyright 2024 Aruj Bansal
+ */
+
+#include "../include/GBlitter.h"
+#include "../include/GCanvas.h"
+#include "../include/GPath.h"
+#include "../include/GRegion.h"
+#include "tests.h"
+#include "tests_utils.h"
+
+static void test_blitters(GTestStats* stats) {
+    GBitmap bm;
+    bm.alloc(30, 30);
+    auto canvas = GCreateCanvas(bm);
+
+    // a concave path, so it goes through the general scan converter
+    const GPoint arrow[] = { {2, 2}, {28, 15}, {2, 28}, {10, 15} };
+    GPath path;
+    path.addPolygon(arrow, 4);
+
+    GCountingBlitter counter;
+    canvas->drawPath(path, counter);
+    EXPECT_TRUE(stats, counter.pixels() > 0);
+    EXPECT_EQ(stats, count_pixels(bm), 0);
+
+    // spans can be captured as a mask, and still drawn while being counted
+    GMaskBlitter mask(GIRect::LTRB(0, 0, 30, 30));
+    GCountingBlitter counting_mask(&mask);
+    canvas->drawPath(path, counting_mask);
+    EXPECT_EQ(stats, counting_mask.spans(), (int64_t)26);
+
+    // a translucent solid paint lands the same color on every covered pixel
+    const GPaint paint(GColor{1, 0.5f, 0, 0.5f});
+    canvas->drawPath(path, paint);
+
+    const GPixel expected = GPixel_PackARGB(128, 128, 64, 0);
+    int covered = 0;
+    bool matches = true;
+    visit_pixels(bm, [&](int x, int y, GPixel* p) {
+        bool in_mask = mask.coverage(x, y) == 255;
+        covered += in_mask;
+        matches &= in_mask ? *p == expected : *p == 0;
+    });
+    EXPECT_TRUE(stats, matches);
+    EXPECT_EQ(stats, (int64_t)covered, counting_mask.pixels());
+
+    free(bm.pixels());
+}
+
+static void test_region(GTestStats* stats) {
+    GRegion a(GIRect::LTRB(0, 0, 10, 10)), b(GIRect::LTRB(5, 5, 20, 8));
+    EXPECT_TRUE(stats, a.isRect());
+
+    GRegion both = a.intersect(b);
+    EXPECT_TRUE(stats, both.isRect());
+    EXPECT_TRUE(stats, both.bounds().left == 5 && both.bounds().top == 5 &&
+                       both.bounds().right == 10 && both.bounds().bottom == 8);
+
+    GRegion either = a.unite(b);
+    EXPECT_FALSE(stats, either.isRect());
+    EXPECT_TRUE(stats, either.contains(15, 6) && either.contains(2, 2));
+    EXPECT_FALSE(stats, either.contains(15, 2) || either.contains(10, 9));
+    EXPECT_EQ(stats, (int)(either.rowEnd(6) - either.rowBegin(6)), 1);
+
+    // disjoint spans in one row stay apart, and intersect down to nothing
+    GRegion c(GIRect::LTRB(30, 0, 40, 10));
+    GRegion gap = a.unite(c);
+    EXPECT_EQ(stats, (int)(gap.rowEnd(3) - gap.rowBegin(3)), 2);
+    EXPECT_TRUE(stats, gap.intersect(GRegion(GIRect::LTRB(12, 0, 28, 10))).isEmpty());
+}
+
+static void test_clip(GTestStats* stats) {
+    GBitmap bm, ref;
+    bm.alloc(40, 40);
+    ref.alloc(40, 40);
+    auto canvas = GCreateCanvas(bm);
+    auto ref_canvas = GCreateCanvas(ref);
+    const GPaint paint(GColor{1, 0, 0, 1});
+    const GRect everything = GRect::WH(40, 40);
+
+    canvas->save();
+    canvas->translate(2, 3);
+    canvas->clipRect(GRect::LTRB(0.5f, 0.5f, 10.5f, 5.5f));
+    EXPECT_TRUE(stats, canvas->getClipBounds().left == 3 && canvas->getClipBounds().top == 4 &&
+                       canvas->getClipBounds().right == 13 && canvas->getClipBounds().bottom == 9);
+    canvas->drawRect(everything, paint);
+    canvas->restore();
+    EXPECT_EQ(stats, count_pixels(bm), 50);
+    EXPECT_TRUE(stats, *bm.getAddr(3, 4) != 0 && *bm.getAddr(12, 8) != 0 && *bm.getAddr(13, 8) == 0);
+    EXPECT_EQ(stats, canvas->getClipBounds().right, 40);
+
+    // a path clip keeps exactly the pixels the path itself would cover, whatever is drawn through it
+    GPath path;
+    path.addCircle({20, 20}, 12);
+    const GPoint arrow[] = { {0, 0}, {40, 20}, {0, 40}, {15, 20} };
+    GPath arrow_path;
+    arrow_path.addPolygon(arrow, 4);
+
+    canvas->clear({0, 0, 0, 0});
+    canvas->save();
+    canvas->clipPath(path);
+    canvas->drawPath(arrow_path, paint);
+    canvas->restore();
+
+    GBitmap circle_bm;
+    circle_bm.alloc(40, 40);
+    GCreateCanvas(circle_bm)->drawPath(path, paint);
+    GCreateCanvas(ref)->drawPath(arrow_path, paint);
+    bool matches = true;
+    visit_pixels(bm, [&](int x, int y, GPixel* p) {
+        bool inside = *circle_bm.getAddr(x, y) != 0 && *ref.getAddr(x, y) != 0;
+        matches &= (*p != 0) == inside;
+    });
+    EXPECT_TRUE(stats, matches);
+
+    // clips only ever shrink, until restored; an empty clip draws nothing
+    canvas->clear({0, 0, 0, 0});
+    canvas->save();
+    canvas->clipRect(GRect::LTRB(0, 0, 10, 10));
+    canvas->clipRect(GRect::LTRB(20, 20, 30, 30));
+    EXPECT_TRUE(stats, canvas->getClipBounds().isEmpty());
+    canvas->drawRect(everything, paint);
+    canvas->drawPath(path, paint);
+    canvas->drawLine({0, 0}, {40, 40}, paint);
+    canvas->drawCircle({5, 5}, 4, paint);
+    canvas->restore();
+    EXPECT_EQ(stats, count_pixels(bm), 0);
+
+    // under a rotation the rect clip becomes a path clip, matching a rotated rect fill
+    canvas->save();
+    canvas->translate(20, 20);
+    canvas->rotate(gFloatPI / 6);
+    canvas->clipRect(GRect::LTRB(-10, -10, 10, 10));
+    canvas->drawRect(GRect::LTRB(-1000, -1000, 1000, 1000), paint);
+    canvas->restore();
+    ref_canvas->clear({0, 0, 0, 0});
+    ref_canvas->translate(20, 20);
+    ref_canvas->rotate(gFloatPI / 6);
+    GPath rotated;
+    rotated.addRect(GRect::LTRB(-10, -10, 10, 10));
+    ref_canvas->drawPath(rotated, paint);
+    EXPECT_EQ(stats, memcmp(bm.pixels(), ref.pixels(), 40 * 40 * sizeof(GPixel)), 0);
+
+    free(bm.pixels());
+    free(ref.pixels());
+    free(circle_bm.pixels());
+}
@@ -0,0 +1,265 @@
+/**
+ *  Copyright 2024 Aruj Bansal
+ */
+
+#include "../include/GBlitter.h"
+#include "../include/GCanvas.h"
+#include "../include/GPath.h"
+#include "../include/GRandom.h"
+#include "../include/GThreadPool.h"
+#include "../include/GTriangleRasterizer.h"
+#include "../shaders/include/GComposeShader.h"
+#include "tests.h"
+#include "tests_utils.h"
+
+static void test_mesh(GTestStats* stats) {
+    GBitmap bm, ref;
+    bm.alloc(64, 64);
+    ref.alloc(64, 64);
+    auto canvas = GCreateCanvas(bm);
+    auto ref_canvas = GCreateCanvas(ref);
+
+    // a grid of shared vertices, drawn as one mesh and as separate triangles
+    const int N = 4;
+    GPoint verts[(N + 1) * (N + 1)];
+    GColor colors[(N + 1) * (N + 1)];
+    for (int i = 0; i <= N; i++) {
+        for (int j = 0; j <= N; j++) {
+            verts[i * (N + 1) + j] = {j * 10.0f + (i & 1) * 3.0f, i * 10.0f};
+            colors[i * (N + 1) + j] = {j / (float) N, i / (float) N, 0.5f, 0.25f + (i + j) / (4.0f * N)};
+        }
+    }
+
+    int indices[N * N * 6], *index = indices;
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            int v = i * (N + 1) + j;
+            const int quad[] = {v, v + 1, v + N + 1, v + 1, v + N + 2, v + N + 1};
+            index = std::copy(quad, quad + 6, index);
+        }
+    }
+
+    for (GCanvas* c: {canvas.get(), ref_canvas.get()}) {
+        c->translate(30, 2);
+        c->rotate(gFloatPI / 5);
+    }
+
+    canvas->drawMesh(verts, colors, nullptr, 2 * N * N, indices, GPaint());
+    for (int t = 0; t < 2 * N * N; t++) {
+        const GPoint pts[] = {verts[indices[3 * t]], verts[indices[3 * t + 1]], verts[indices[3 * t + 2]]};
+        const GColor cols[] = {colors[indices[3 * t]], colors[indices[3 * t + 1]], colors[indices[3 * t + 2]]};
+
+        auto shader = GCreateTriangleGradient(pts, cols);
+        ref_canvas->drawConvexPolygon(pts, 3, GPaint(shader.get()));
+    }
+
+    EXPECT_TRUE(stats, count_pixels(bm) > 0);
+    EXPECT_TRUE(stats, max_channel_diff(bm, ref) <= 1);
+
+    // triangles whose texture coordinates are degenerate are skipped, the rest still draw
+    GBitmap tex;
+    tex.alloc(2, 2);
+    visit_pixels(tex, [](int, int, GPixel* p) { *p = GPixel_PackARGB(255, 0, 0, 255); });
+    auto tex_shader = GCreateBitmapShader(tex, GMatrix());
+
+    const GPoint texs[] = {{0, 0}, {1, 1}, {2, 2}, {0, 2}};
+    const GPoint quad_verts[] = {{0, 0}, {20, 0}, {20, 20}, {0, 20}};
+    const int quad_indices[] = {0, 1, 2, 0, 2, 3};
+
+    GBitmap tex_bm;
+    tex_bm.alloc(20, 20);
+    GCreateCanvas(tex_bm)->drawMesh(quad_verts, nullptr, texs, 2, quad_indices, GPaint(tex_shader.get()));
+    EXPECT_EQ(stats, *tex_bm.getAddr(15, 5), (GPixel) 0);
+    EXPECT_EQ(stats, *tex_bm.getAddr(5, 15), GPixel_PackARGB(255, 0, 0, 255));
+
+    free(bm.pixels());
+    free(ref.pixels());
+    free(tex.pixels());
+    free(tex_bm.pixels());
+}
+
+static void test_quad(GTestStats* stats) {
+    const GPoint verts[] = { {2, 3}, {40, 1}, {44, 38}, {0, 30} };
+    const GColor colors[] = { {1, 0, 0, 1}, {0, 1, 0, 1}, {0, 0, 1, 1}, {1, 1, 1, 0.5f} };
+
+    auto draw = [&](GCanvas* canvas, int level) {
+        canvas->clear({0, 0, 0, 0});
+        canvas->drawQuad(verts, colors, nullptr, level, GPaint());
+    };
+
+    GBitmap bm, ref;
+    bm.alloc(48, 48);
+    ref.alloc(48, 48);
+    auto canvas = GCreateCanvas(bm);
+
+    // switching levels on one canvas draws the same as a fresh canvas at each level
+    for (int level: {3, 0, 9, 3}) {
+        draw(canvas.get(), level);
+        draw(GCreateCanvas(ref).get(), level);
+        EXPECT_EQ(stats, memcmp(bm.pixels(), ref.pixels(), 48 * 48 * sizeof(GPixel)), 0);
+    }
+
+    // finer lattices only move the quad's sides by rounding
+    GBitmap poly;
+    poly.alloc(48, 48);
+    GCreateCanvas(poly)->drawConvexPolygon(verts, 4, GPaint());
+    for (int level: {0, 16}) {
+        draw(canvas.get(), level);
+        EXPECT_TRUE(stats, std::abs(count_pixels(bm) - count_pixels(poly)) <= count_pixels(poly) / 100);
+    }
+
+    free(bm.pixels());
+    free(ref.pixels());
+    free(poly.pixels());
+}
+
+static void test_triangle_rasterizer(GTestStats* stats) {
+    const GIRect bounds = GIRect::WH(64, 64);
+    GRandom rand(11);
+
+    bool watertight = true, clipped_same = true;
+    for (int n = 0; n < 50; n++) {
+        // a random quad inscribed in a circle (so convex), split along a diagonal and as a fan around its center; corners land on the
+        // pixel grid now and then, so centers exactly on edges are exercised
+        GPoint q[4];
+        float radius = 10 + rand.nextF() * 20;
+        for (int k = 0; k < 4; k++) {
+            float angle = (k + rand.nextF() * 0.8f) * gFloatPI / 2;
+            q[k] = {32 + radius * cosf(angle), 32 + radius * sinf(angle)};
+            if (n % 3 == 0) q[k] = {roundf(q[k].x * 2) / 2, roundf(q[k].y * 2) / 2};
+        }
+        GPoint center = (q[0] + q[1] + q[2] + q[3]) * 0.25f;
+
+        GMaskBlitter split_mask(bounds), fan_mask(bounds);
+        GCountingBlitter split(&split_mask), fan(&fan_mask);
+
+        const GPoint halves[2][3] = { {q[0], q[1], q[2]}, {q[2], q[3], q[0]} };
+        for (auto& tri: halves) GRasterizeTriangle(tri, bounds, split);
+        for (int k = 0; k < 4; k++) {
+            const GPoint tri[] = {center, q[k], q[(k + 1) % 4]};
+            GRasterizeTriangle(tri, bounds, fan);
+        }
+
+        // no pixel is drawn twice, and both tessellations cover the same ones
+        int64_t covered = 0;
+        for (int y = 0; y < 64; y++) {
+            for (int x = 0; x < 64; x++) {
+                covered += split_mask.coverage(x, y) != 0;
+                watertight &= split_mask.coverage(x, y) == fan_mask.coverage(x, y);
+            }
+        }
+        watertight &= split.pixels() == covered && fan.pixels() == covered;
+
+        // clipping only removes pixels
+        const GIRect clip = GIRect::LTRB(20, 13, 41, 50);
+        GMaskBlitter clip_mask(bounds);
+        for (auto& tri: halves) GRasterizeTriangle(tri, clip, clip_mask);
+        for (int y = 0; y < 64; y++) {
+            for (int x = 0; x < 64; x++) {
+                bool inside = x >= clip.left && x < clip.right && y >= clip.top && y < clip.bottom;
+                clipped_same &= clip_mask.coverage(x, y) == (inside ? split_mask.coverage(x, y) : 0);
+            }
+        }
+    }
+
+    EXPECT_TRUE(stats, watertight);
+    EXPECT_TRUE(stats, clipped_same);
+
+    // corners too far out are refused rather than overflowing
+    GCountingBlitter counter;
+    const GPoint huge[] = { {-1e9f, 0}, {1e9f, 0}, {0, 1e9f} };
+    EXPECT_FALSE(stats, GRasterizeTriangle(huge, bounds, counter));
+    EXPECT_EQ(stats, (int) counter.pixels(), 0);
+}
+
+static void test_thread_pool(GTestStats* stats) {
+    GThreadPool pool(3);
+    EXPECT_EQ(stats, pool.threads(), 4);
+
+    // every index runs exactly once, job after job
+    for (int count: {1, 7, 1000}) {
+        std::vector<std::atomic<int>> hits(count);
+        pool.parallelFor(count, [&](int i) { hits[i]++; });
+
+        bool once = true;
+        for (auto& hit: hits) once &= hit == 1;
+        EXPECT_TRUE(stats, once);
+    }
+
+    // many short jobs back to back, each a different size, so workers still waking from one find the next
+    bool exact = true;
+    for (int job = 0; job < 2000; job++) {
+        int count = 2 + job % 13;
+        std::vector<std::atomic<int>> hits(count);
+        pool.parallelFor(count, [&](int i) { hits[i] += job; });
+
+        for (auto& hit: hits) exact &= hit == job;
+    }
+    EXPECT_TRUE(stats, exact);
+}
+
+static void test_mesh_threads(GTestStats* stats) {
+    // overlapping translucent triangles, so any change in drawing order would show
+    const int TRIS = 2000;
+    std::vector<GPoint> verts;
+    std::vector<GColor> colors;
+    std::vector<int> indices;
+
+    std::vector<GPoint> texs;
+
+    GRandom rand(7);
+    for (int i = 0; i < 3 * TRIS; i++) {
+        verts.push_back({rand.nextF() * 140 - 6, rand.nextF() * 140 - 6});
+        colors.push_back({rand.nextF(), rand.nextF(), rand.nextF(), 0.2f + 0.6f * rand.nextF()});
+        texs.push_back({rand.nextF() * 24, rand.nextF() * 24});
+        indices.push_back(i);
+    }
+
+    GBitmap tex;
+    tex.alloc(16, 16);
+    visit_pixels(tex, [](int x, int y, GPixel* p) {
+        int a = 80 + x * 10;
+        *p = GPixel_PackARGB(a, a * x / 16, a * y / 16, a / 2);
+    });
+    auto shader = GCreateBitmapShader(tex, GMatrix(), GTileMode::kMirror, GMipmapMode::kNearest);
+
+    // colored, textured, and both: a textured mesh's bands each make their own contexts from the shared shader
+    const GColor* mesh_colors[] = {colors.data(), nullptr, colors.data()};
+    const GPoint* mesh_texs[] = {nullptr, texs.data(), texs.data()};
+
+    GThreadPool serial(0), threaded(3);
+    bool same = true;
+    for (int m = 0; m < 3; m++) {
+        GBitmap bm[2];
+        for (int i = 0; i < 2; i++) {
+            bm[i].alloc(128, 128);
+            auto canvas = GCreateCanvas(bm[i]);
+            canvas->setThreadPool(i == 0 ? &serial : &threaded);
+            canvas->clear({1, 1, 1, 1});
+
+            GPath clip;
+            clip.addCircle({64, 64}, 60);
+            canvas->clipPath(clip);
+            canvas->drawMesh(verts.data(), mesh_colors[m], mesh_texs[m], TRIS, indices.data(),
+                             GPaint(shader.get()));
+        }
+
+        same &= memcmp(bm[0].pixels(), bm[1].pixels(), 128 * 128 * sizeof(GPixel)) == 0;
+        free(bm[0].pixels());
+        free(bm[1].pixels());
+    }
+    EXPECT_TRUE(stats, same);
+
+    // only shaders that keep their context in themselves, even behind another shader, are drawn by one thread
+    struct Single : GSingleContextShader {
+        bool isOpaque() override { return true; }
+        bool setContext(const GMatrix&) override { return true; }
+        void shadeRow(int, int, int count, GPixel row[]) override { std::fill(row, row + count, 0xFF808080); }
+    } single;
+    EXPECT_TRUE(stats, shader->isThreadSafe());
+    EXPECT_FALSE(stats, single.isThreadSafe());
+    EXPECT_FALSE(stats, GCreateProxyShader(single, GMatrix())->isThreadSafe());
+    EXPECT_FALSE(stats, GCreateTriangleCompose(*shader, single)->isThreadSafe());
+
+    free(tex.pixels());
+}
@@ -101,11 +101,13 @@ static void test_clamp_shader(GTestStats* stats) {
         EXPECT_TRUE(stats, false);
         return;
     }
-    EXPECT_TRUE(stats, sh->setContext(GMatrix()));
+    GArena arena;
+    GShader::Context* ctx = sh->makeContext(GMatrix(), arena);
+    EXPECT_TRUE(stats, ctx != nullptr);
 
     GPixel row[4];
     for (int y = -1; y < 3; ++y) {
-        sh->shadeRow(-1, y, 4, row);
+        ctx->shadeRow(-1, y, 4, row);
         // since we're clamping, we should always return G
         bool isG = true;
         for (int x = 0; x < 4; ++x) {
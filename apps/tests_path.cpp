@@ -0,0 +1,304 @@
+/**
+ *  Copyright 2024 Aruj Bansal
+ */
+
+#include "../include/GCanvas.h"
+#include "../include/GPath.h"
+#include "../include/GThreadPool.h"
+#include "tests.h"
+#include "tests_utils.h"
+
+static bool same_path(const GPath& a, const GPath& b) {
+    GPath::Iter iter_a(a), iter_b(b);
+    GPoint pts_a[GPath::kMaxNextPoints], pts_b[GPath::kMaxNextPoints];
+
+    for (;;) {
+        auto va = iter_a.next(pts_a);
+        auto vb = iter_b.next(pts_b);
+        if (va.has_value() != vb.has_value()) {
+            return false;
+        }
+        if (!va.has_value()) {
+            return true;
+        }
+        if (va.value() != vb.value()) {
+            return false;
+        }
+        int count = va.value() == GPath::kMove ? 1 : va.value() + 1;
+        for (int i = 0; i < count; ++i) {
+            if (pts_a[i] != pts_b[i]) {
+                return false;
+            }
+        }
+    }
+}
+
+static void test_path_copy_on_write(GTestStats* stats) {
+    EXPECT_EQ(stats, (int)sizeof(GPath::Verb), 1);
+
+    GPath a;
+    a.moveTo(0, 0); a.lineTo(10, 0); a.lineTo(10, 10);
+
+    GPath b = a;
+    EXPECT_TRUE(stats, same_path(a, b));
+
+    b.lineTo(0, 10);
+    EXPECT_EQ(stats, a.countPoints(), 3);
+    EXPECT_EQ(stats, b.countPoints(), 4);
+
+    GPath c = b;
+    c.transform(GMatrix::Translate(5, 5));
+    GPoint pts[GPath::kMaxNextPoints];
+    GPath::Iter iter(b);
+    iter.next(pts);
+    EXPECT_TRUE(stats, pts[0] == GPoint({0, 0}));
+
+    GPath d = std::move(c);
+    EXPECT_EQ(stats, d.countPoints(), 4);
+    EXPECT_EQ(stats, c.countPoints(), 0);
+
+    c = a;
+    a.reset();
+    EXPECT_EQ(stats, a.countPoints(), 0);
+    EXPECT_EQ(stats, c.countPoints(), 3);
+}
+
+static void test_path_bulk_polygon(GTestStats* stats) {
+    const GPoint pts[] = { {1, 2}, {30, 4}, {25, 60}, {-3, 40}, {0, 5} };
+    const int N = GARRAY_COUNT(pts);
+
+    GPath bulk, manual;
+    bulk.reserve(2 * N, 2 * N);
+    bulk.addPolygon(pts, N);
+    bulk.addPolygon(pts, N);
+    for (int c = 0; c < 2; ++c) {
+        manual.moveTo(pts[0]);
+        for (int i = 1; i < N; ++i) {
+            manual.lineTo(pts[i]);
+        }
+    }
+    EXPECT_EQ(stats, bulk.countVerbs(), 2 * N);
+    EXPECT_TRUE(stats, same_path(bulk, manual));
+}
+
+static void test_path_cached_bounds(GTestStats* stats) {
+    GPath path;
+    EXPECT_TRUE(stats, path.controlBounds() == GRect::LTRB(0, 0, 0, 0));
+
+    path.moveTo(0, 0);
+    path.quadTo(20, 40, 40, 0);
+    EXPECT_TRUE(stats, path.controlBounds() == GRect::LTRB(0, 0, 40, 40));
+    EXPECT_TRUE(stats, path.bounds() == GRect::LTRB(0, 0, 40, 20));
+
+    // the cached tight bounds must notice later edits
+    path.lineTo(-10, 5);
+    EXPECT_TRUE(stats, path.bounds() == GRect::LTRB(-10, 0, 40, 20));
+    EXPECT_TRUE(stats, path.controlBounds() == GRect::LTRB(-10, 0, 40, 40));
+
+    GPath copy = path;
+    copy.transform(GMatrix::Translate(10, 10));
+    EXPECT_TRUE(stats, copy.bounds() == GRect::LTRB(0, 10, 50, 30));
+    EXPECT_TRUE(stats, copy.controlBounds() == GRect::LTRB(0, 10, 50, 50));
+    EXPECT_TRUE(stats, path.bounds() == GRect::LTRB(-10, 0, 40, 20));
+
+    // copies share storage, so threads may fill in its cached bounds at the same time
+    copy.lineTo(60, 25);
+    std::vector<GPath> copies(16, copy);
+    std::vector<GRect> got(copies.size());
+    GThreadPool pool(3);
+    pool.parallelFor((int) copies.size(), [&](int i) { got[i] = copies[i].bounds(); });
+
+    bool same = true;
+    for (const GRect& r: got)
+        same &= r == GRect::LTRB(0, 10, 60, 30);
+    EXPECT_TRUE(stats, same);
+}
+
+static void test_path_convexity(GTestStats* stats) {
+    GPath path;
+    EXPECT_FALSE(stats, path.isConvex());
+
+    path.addRect(GRect::LTRB(0, 0, 10, 10));
+    EXPECT_TRUE(stats, path.isConvex());
+
+    // a second contour is never convex
+    path.addRect(GRect::LTRB(20, 0, 30, 10));
+    EXPECT_FALSE(stats, path.isConvex());
+
+    path.reset();
+    path.addCircle({50, 50}, 20);
+    EXPECT_TRUE(stats, path.isConvex());
+
+    // concave arrow head
+    const GPoint arrow[] = { {0, 0}, {10, 5}, {0, 10}, {3, 5} };
+    path.reset();
+    path.addPolygon(arrow, 4);
+    EXPECT_FALSE(stats, path.isConvex());
+
+    // a pentagram turns the same way at every vertex, but winds around twice
+    GPoint star[5];
+    for (int i = 0; i < 5; ++i) {
+        float angle = i * 4 * gFloatPI / 5;
+        star[i] = { cosf(angle), sinf(angle) };
+    }
+    path.reset();
+    path.addPolygon(star, 5);
+    EXPECT_FALSE(stats, path.isConvex());
+
+    // repeated points are harmless
+    const GPoint tri[] = { {0, 0}, {0, 0}, {10, 0}, {5, 8}, {0, 0} };
+    path.reset();
+    path.addPolygon(tri, 5);
+    EXPECT_TRUE(stats, path.isConvex());
+
+    // copies share storage, so threads drawing them may fill in its cached convexity at the same time
+    path.reset();
+    path.addCircle({20, 20}, 15);
+    std::vector<GPath> copies(16, path);
+    std::vector<int> convex(copies.size());
+    GThreadPool pool(3);
+    pool.parallelFor((int) copies.size(), [&](int i) { convex[i] = copies[i].isConvex(); });
+    EXPECT_EQ(stats, (int) std::count(convex.begin(), convex.end(), 1), (int) copies.size());
+}
+
+static void test_path_is_rect(GTestStats* stats) {
+    GRect rect;
+    GPath::Direction dir;
+
+    GPath path;
+    path.addRect(GRect::LTRB(1, 2, 30, 40), GPath::kCCW_Direction);
+    EXPECT_TRUE(stats, path.isRect(&rect, &dir));
+    EXPECT_TRUE(stats, rect == GRect::LTRB(1, 2, 30, 40));
+    EXPECT_TRUE(stats, dir == GPath::kCCW_Direction);
+
+    // the same rect spelled out by hand, closed back to the start
+    const GPoint pts[] = { {30, 40}, {1, 40}, {1, 2}, {30, 2}, {30, 40} };
+    path.reset();
+    path.addPolygon(pts, 5);
+    EXPECT_TRUE(stats, path.isRect(&rect, &dir));
+    EXPECT_TRUE(stats, rect == GRect::LTRB(1, 2, 30, 40));
+    EXPECT_TRUE(stats, dir == GPath::kCW_Direction);
+
+    const GPoint skewed[] = { {0, 0}, {10, 0}, {10, 10}, {1, 10} };
+    path.reset();
+    path.addPolygon(skewed, 4);
+    EXPECT_FALSE(stats, path.isRect());
+
+    path.reset();
+    path.addRect(GRect::LTRB(5, 5, 5, 20));
+    EXPECT_FALSE(stats, path.isRect());
+
+    // the rect fast path must cover exactly what the general scan converter does
+    GBitmap fast, general;
+    fast.alloc(40, 40);
+    general.alloc(40, 40);
+    auto fast_canvas = GCreateCanvas(fast);
+    auto general_canvas = GCreateCanvas(general);
+    const GPaint paint(GColor{0, 0.5f, 1, 1});
+
+    const GRect rects[] = {
+        GRect::LTRB(0.5f, 0.5f, 10.5f, 10.49f), GRect::LTRB(-7.3f, 3.2f, 12.6f, 55.1f),
+        GRect::LTRB(20.2f, -4, 80, 21.7f), GRect::LTRB(3.7f, 30.1f, 3.9f, 33.8f),
+    };
+    for (const GRect& r : rects) {
+        GPath rect_path;
+        rect_path.addRect(r);
+        GPath general_path = rect_path;
+        general_path.moveTo(-100, -100);
+        general_path.lineTo(-100, -100);
+        GPath general_offset = general_path;
+        general_offset.offset(2, 2);
+
+        for (auto canvas : { fast_canvas.get(), general_canvas.get() }) {
+            canvas->save();
+            canvas->translate(1.25f, -0.5f);
+            canvas->scale(1.5f, 0.75f);
+        }
+        fast_canvas->drawPath(rect_path, paint);
+        general_canvas->drawPath(general_path, paint);
+        fast_canvas->drawRect(r.offset(2, 2), paint);
+        general_canvas->drawPath(general_offset, paint);
+        fast_canvas->restore();
+        general_canvas->restore();
+    }
+    EXPECT_EQ(stats, memcmp(fast.pixels(), general.pixels(), 40 * 40 * sizeof(GPixel)), 0);
+
+    free(fast.pixels());
+    free(general.pixels());
+}
+
+static void test_hairline(GTestStats* stats) {
+    GBitmap bm;
+    bm.alloc(10, 10);
+    auto canvas = GCreateCanvas(bm);
+    const GPaint paint(GColor{1, 1, 1, 1});
+
+    canvas->drawLine({1, 2.5f}, {8, 2.5f}, paint);
+    EXPECT_EQ(stats, count_pixels(bm), 7);
+    EXPECT_TRUE(stats, *bm.getAddr(1, 2) != 0 && *bm.getAddr(7, 2) != 0 && *bm.getAddr(8, 2) == 0);
+
+    // one pixel per row along the diagonal, clipped to the device
+    canvas->clear({0, 0, 0, 0});
+    canvas->drawLine({-5, -5}, {20, 20}, paint);
+    EXPECT_EQ(stats, count_pixels(bm), 10);
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_TRUE(stats, *bm.getAddr(i, i) != 0);
+    }
+
+    canvas->clear({0, 0, 0, 0});
+    canvas->drawLine({-5, 3}, {-1, 8}, paint);
+    canvas->drawLine({2, 12}, {8, 30}, paint);
+    EXPECT_EQ(stats, count_pixels(bm), 0);
+
+    free(bm.pixels());
+}
+
+static void test_oval(GTestStats* stats) {
+    GBitmap bm;
+    bm.alloc(40, 40);
+    auto canvas = GCreateCanvas(bm);
+    const GPaint paint(GColor{1, 1, 1, 1});
+
+    // a circle centered between pixels is symmetric in both axes, and close to pi r^2
+    canvas->drawCircle({20, 20}, 10, paint);
+    int area = count_pixels(bm);
+    EXPECT_TRUE(stats, std::abs(area - 314) < 10);
+    bool symmetric = true;
+    visit_pixels(bm, [&](int x, int y, GPixel* p) {
+        symmetric &= *p == *bm.getAddr(39 - x, y) && *p == *bm.getAddr(x, 39 - y);
+    });
+    EXPECT_TRUE(stats, symmetric);
+
+    // radii larger than the rect clamp to an oval
+    GBitmap oval;
+    oval.alloc(40, 40);
+    auto oval_canvas = GCreateCanvas(oval);
+    canvas->clear({0, 0, 0, 0});
+    canvas->drawRRect(GRect::LTRB(3, 5, 31, 22), 100, 100, paint);
+    oval_canvas->drawOval(GRect::LTRB(31, 22, 3, 5), paint);
+    EXPECT_EQ(stats, memcmp(bm.pixels(), oval.pixels(), 40 * 40 * sizeof(GPixel)), 0);
+
+    // a rounded rect only loses its corners
+    canvas->clear({0, 0, 0, 0});
+    canvas->drawRRect(GRect::LTRB(0, 0, 40, 40), 4, 4, paint);
+    EXPECT_TRUE(stats, *bm.getAddr(0, 0) == 0 && *bm.getAddr(0, 20) != 0 && *bm.getAddr(20, 39) != 0);
+    EXPECT_TRUE(stats, count_pixels(bm) > 1600 - 16 && count_pixels(bm) < 1600);
+
+    // under a rotation the oval is drawn as a path, and covers about the same area
+    canvas->clear({0, 0, 0, 0});
+    canvas->save();
+    canvas->translate(20, 20);
+    canvas->rotate(gFloatPI / 4);
+    canvas->drawCircle({0, 0}, 10, paint);
+    canvas->restore();
+    EXPECT_TRUE(stats, std::abs(count_pixels(bm) - area) < 15);
+
+    // partly and fully off the device
+    canvas->clear({0, 0, 0, 0});
+    canvas->drawCircle({-5, 38}, 12, paint);
+    canvas->drawOval(GRect::LTRB(-30, -30, -10, 80), paint);
+    EXPECT_TRUE(stats, *bm.getAddr(0, 39) != 0 && *bm.getAddr(20, 20) == 0);
+
+    free(bm.pixels());
+    free(oval.pixels());
+}
@@ -2,6 +2,7 @@
  *  Copyright 2015 Mike Reed
  */
 
+#include "../include/GArena.h"
 #include "../include/GCanvas.h"
 #include "../include/GBitmap.h"
 #include "../include/GColor.h"
@@ -14,6 +15,11 @@
 #include "tests_pa3.cpp"
 #include "tests_pa4.cpp"
 #include "tests_pa5.cpp"
+#include "tests_path.cpp"
+#include "tests_clip.cpp"
+#include "tests_mesh.cpp"
+#include "tests_shaders.cpp"
+#include "tests_bitmap.cpp"
 
 const GTestRec gTestRecs[] = {
     { test_clear,       "clear"         },
@@ -39,6 +45,40 @@ const GTestRec gTestRecs[] = {
     { test_path_chop_cubic,   "path_chop_cubic"    },
     { test_path_bounds, "path_bounds" },
 
+    { test_path_copy_on_write,       "path_copy_on_write"      },
+    { test_path_bulk_polygon,        "path_bulk_polygon"       },
+    { test_path_cached_bounds,       "path_cached_bounds"      },
+    { test_path_convexity,           "path_convexity"          },
+    { test_path_is_rect,             "path_is_rect"            },
+    { test_hairline,                 "hairline"                },
+    { test_oval,                     "oval"                    },
+
+    { test_blitters,                 "blitters"                },
+    { test_region,                   "region"                  },
+    { test_clip,                     "clip"                    },
+
+    { test_mesh,                     "mesh"                    },
+    { test_quad,                     "quad"                    },
+    { test_triangle_rasterizer,      "triangle_rasterizer"     },
+    { test_thread_pool,              "thread_pool"             },
+    { test_mesh_threads,             "mesh_threads"            },
+
+    { test_triangle_gradient_steps,  "triangle_gradient_steps" },
+    { test_compose_shader,           "compose_shader"          },
+    { test_gradient_lut,             "gradient_lut"            },
+    { test_gradient_seams,           "gradient_seams"          },
+    { test_shader_invariance,        "shader_invariance"       },
+    { test_shader_constants,         "shader_constants"        },
+    { test_shade_spans,              "shade_spans"             },
+    { test_shader_contexts,          "shader_contexts"         },
+
+    { test_bitmap_sampling,          "bitmap_sampling"         },
+    { test_tile_stepping,            "tile_stepping"           },
+    { test_texel_edges,              "texel_edges"             },
+    { test_texture_layout,           "texture_layout"          },
+    { test_mipmaps,                  "mipmaps"                 },
+    { test_read_png,                 "read_png"                },
+
     { nullptr, nullptr },
 };
 
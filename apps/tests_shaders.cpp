@@ -0,0 +1,536 @@
+/**
+ *  Copyright 2024 Aruj Bansal
+ */
+
+#include "../include/GArena.h"
+#include "../include/GBlitter.h"
+#include "../include/GCanvas.h"
+#include "../include/GPath.h"
+#include "../include/GRandom.h"
+#include "../include/GThreadPool.h"
+#include "../shaders/include/GComposeShader.h"
+#include "../shaders/include/GTriangleGradientShader.h"
+#include "tests.h"
+#include "tests_utils.h"
+
+static void test_triangle_gradient_steps(GTestStats* stats) {
+    const GPoint pts[] = { {0, 0}, {2000, 0}, {0, 2000} };
+    const GColor cols[] = { {1, 0, 0, 1}, {0, 1, 0.5f, 0.25f}, {0, 0, 1, 0.75f} };
+    auto shader = GCreateTriangleGradient(pts, cols);
+    GArena arena;
+    GShader::Context* ctx = shader->makeContext(GMatrix(), arena);
+    EXPECT_TRUE(stats, ctx != nullptr);
+
+    // long spans, including ones that run past the triangle at either end, stay within a unit of
+    // evaluating every pixel on its own
+    const int N = 1800;
+    GPixel row[N];
+    bool close = true;
+
+    for (int y: {0, 10, 1000, 1999}) {
+        for (int x0: {-20, 0, 5}) {
+            ctx->shadeRow(x0, y, N, row);
+
+            for (int i = 0; i < N; i++) {
+                float u = (x0 + i + 0.5f) / 2000, v = (y + 0.5f) / 2000;
+                GPixel want = gutils::premul_255_clamp(cols[0] + u * (cols[1] - cols[0]) + v * (cols[2] - cols[0]));
+
+                // only pixels inside the triangle are defined away from the span ends
+                if (i != 0 && i != N - 1 && (u < 0 || u + v > 1)) continue;
+
+                for (int shift: {0, 8, 16, 24}) {
+                    close &= std::abs((int) ((row[i] >> shift) & 0xFF) - (int) ((want >> shift) & 0xFF)) <= 1;
+                }
+            }
+        }
+    }
+
+    EXPECT_TRUE(stats, close);
+}
+
+static void test_compose_shader(GTestStats* stats) {
+    // two bitmaps, one opaque and one not, so both the full and the alpha-keeping modulate are covered
+    GBitmap opaque, translucent;
+    opaque.alloc(13, 7);
+    translucent.alloc(11, 5);
+
+    GRandom rand(3);
+    visit_pixels(opaque, [&](int, int, GPixel* p) {
+        *p = GPixel_PackARGB(255, rand.nextU() & 0xFF, rand.nextU() & 0xFF, rand.nextU() & 0xFF);
+    });
+    visit_pixels(translucent, [&](int, int, GPixel* p) {
+        unsigned a = rand.nextU() & 0xFF;
+        *p = GPixel_PackARGB(a, rand.nextU() % (a + 1), rand.nextU() % (a + 1), rand.nextU() % (a + 1));
+    });
+
+    auto first = GCreateBitmapShader(opaque, GMatrix::Scale(0.5f, 0.5f), GTileMode::kRepeat);
+    auto second = GCreateBitmapShader(translucent, GMatrix(), GTileMode::kMirror);
+
+    for (auto [a, b]: {std::make_pair(first.get(), second.get()), std::make_pair(second.get(), second.get())}) {
+        GComposeShader compose(*a, *b);
+        const GMatrix ctm = GMatrix::Translate(2.5f, -1) * GMatrix::Scale(0.75f, 1.5f);
+        GArena arena;
+        GShader::Context* ctx = compose.makeContext(ctm, arena);
+        GShader::Context* ctx_a = a->makeContext(ctm, arena);
+        GShader::Context* ctx_b = b->makeContext(ctm, arena);
+        EXPECT_TRUE(stats, ctx && ctx_a && ctx_b);
+
+        // longer than one chunk, so the row is shaded in pieces
+        const int N = 150;
+        GPixel row[N], row_a[N], row_b[N];
+        ctx->shadeRow(-3, 4, N, row);
+        ctx_a->shadeRow(-3, 4, N, row_a);
+        ctx_b->shadeRow(-3, 4, N, row_b);
+
+        bool same = true;
+        for (int i = 0; i < N; i++) {
+            for (int shift: {0, 8, 16, 24}) {
+                int want = gutils::divBy255((int) ((row_a[i] >> shift) & 0xFF) * (int) ((row_b[i] >> shift) & 0xFF));
+                same &= (int) ((row[i] >> shift) & 0xFF) == want;
+            }
+        }
+        EXPECT_TRUE(stats, same);
+    }
+
+    free(opaque.pixels());
+    free(translucent.pixels());
+}
+
+static void test_gradient_lut(GTestStats* stats) {
+    const GColor colors[] = {{1, 0, 0, 1}, {0, 1, 0, 0.5f}, {0, 0, 1, 1}, {1, 1, 1, 0}};
+    const struct {
+        GPoint p0, p1;
+    } lines[] = {
+        {{20, 10}, {70, 40}},   // runs into the ends on both sides
+        {{90, 5}, {15, 50}},    // steps backwards
+        {{30, 0}, {30, 60}},    // the same t across each row
+        {{41, 20}, {43.5f, 21}}, // several periods per pixel
+    };
+
+    GBitmap bm;
+    bm.alloc(100, 60);
+    auto canvas = GCreateCanvas(bm);
+
+    // away from a repeat's seams, the table lands within rounding of interpolating each pixel on its own
+    int worst = 0;
+    for (GTileMode mode: {GTileMode::kClamp, GTileMode::kRepeat, GTileMode::kMirror}) {
+        for (const auto& line: lines) {
+            auto shader = GCreateLinearGradient(line.p0, line.p1, colors, 4, mode);
+            GPaint paint(shader.get());
+            paint.setBlendMode(GBlendMode::kSrc);
+            canvas->drawRect(GRect::WH(100, 60), paint);
+
+            const float dx = line.p1.x - line.p0.x, dy = line.p1.y - line.p0.y;
+            visit_pixels(bm, [&](int x, int y, GPixel* p) {
+                float t = ((x + 0.5f - line.p0.x) * dx + (y + 0.5f - line.p0.y) * dy) / (dx * dx + dy * dy);
+                if (mode == GTileMode::kClamp) t = std::max(0.0f, std::min(1.0f, t));
+                else if (mode == GTileMode::kRepeat) t -= std::floor(t);
+                else t = 1 - std::abs(t - 2 * std::floor(t / 2) - 1);
+
+                float seam = t - std::floor(t);
+                if (mode == GTileMode::kRepeat && (seam < 0.002f || seam > 0.998f)) return;
+
+                float scaled = t * 3;
+                int k = std::min(2, (int) scaled);
+                float d = scaled - k;
+                auto lerp = [&](float GColor::* c) { return colors[k].*c + d * (colors[k + 1].*c - colors[k].*c); };
+                float a = lerp(&GColor::a);
+                GPixel want = GPixel_PackARGB(GRoundToInt(a * 255), GRoundToInt(a * lerp(&GColor::r) * 255),
+                                              GRoundToInt(a * lerp(&GColor::g) * 255),
+                                              GRoundToInt(a * lerp(&GColor::b) * 255));
+
+                worst = std::max({worst, std::abs(GPixel_GetA(*p) - GPixel_GetA(want)),
+                                  std::abs(GPixel_GetR(*p) - GPixel_GetR(want)),
+                                  std::abs(GPixel_GetG(*p) - GPixel_GetG(want)),
+                                  std::abs(GPixel_GetB(*p) - GPixel_GetB(want))});
+            });
+        }
+    }
+    EXPECT_TRUE(stats, worst <= 2);
+
+    free(bm.pixels());
+}
+
+static void test_gradient_seams(GTestStats* stats) {
+    const GColor colors[] = {{1, 0, 0, 1}, {0, 1, 0, 0.5f}, {0, 0, 1, 1}};
+    const GPixel first = gutils::premul_255(colors[0]), last = gutils::premul_255(colors[2]);
+
+    // t at the pixel centers is x / 8, exactly, so every eighth center sits on a seam or an end
+    const GPoint p0 = {0.5f, 0}, p1 = {8.5f, 0};
+
+    // the per pixel float lerp the table replaced
+    auto lerp = [&](float t, GTileMode mode) {
+        if (mode == GTileMode::kClamp) {
+            if (t <= 0) return first;
+            if (t >= 1) return last;
+        } else if (mode == GTileMode::kRepeat) {
+            t -= std::floor(t);
+        } else {
+            t = t * 0.5f - std::floor(t * 0.5f);
+            t = 2 * (t > 0.5f ? 1 - t : t);
+        }
+
+        float scaled = t * 2;
+        int k = std::min(1, GFloorToInt(scaled));
+        float d = scaled - k;
+        const GColor &c0 = colors[k], &c1 = colors[k + 1];
+        return gutils::premul_255({c0.r + d * (c1.r - c0.r), c0.g + d * (c1.g - c0.g), c0.b + d * (c1.b - c0.b),
+                                   c0.a + d * (c1.a - c0.a)});
+    };
+
+    auto diff = [](GPixel a, GPixel b) {
+        return std::max({std::abs(GPixel_GetA(a) - GPixel_GetA(b)), std::abs(GPixel_GetR(a) - GPixel_GetR(b)),
+                         std::abs(GPixel_GetG(a) - GPixel_GetG(b)), std::abs(GPixel_GetB(a) - GPixel_GetB(b))});
+    };
+
+    // spans starting before, on and between seams, running over several periods
+    int worst = 0;
+    for (GTileMode mode: {GTileMode::kClamp, GTileMode::kRepeat, GTileMode::kMirror}) {
+        auto shader = GCreateLinearGradient(p0, p1, colors, 3, mode);
+        GArena arena;
+        GShader::Context* ctx = shader->makeContext(GMatrix(), arena);
+        EXPECT_TRUE(stats, ctx != nullptr);
+
+        for (int x0: {-20, -1, 0, 3, 8, 16}) {
+            const int N = 50;
+            GPixel row[N];
+            ctx->shadeRow(x0, 0, N, row);
+
+            for (int i = 0; i < N; i++)
+                worst = std::max(worst, diff(row[i], lerp((x0 + i) / 8.0f, mode)));
+        }
+    }
+    EXPECT_TRUE(stats, worst <= 1);
+
+    // a center exactly on a seam starts the next period: t = 1 and 2 are the first color again for repeat, and
+    // the last then the first for mirror; the ends of clamp are the end colors
+    auto shade = [&](GTileMode mode, int x) {
+        auto shader = GCreateLinearGradient(p0, p1, colors, 3, mode);
+        GArena arena;
+        GPixel px = 0;
+        if (GShader::Context* ctx = shader->makeContext(GMatrix(), arena)) ctx->shadeRow(x, 0, 1, &px);
+        return px;
+    };
+    EXPECT_TRUE(stats, diff(shade(GTileMode::kRepeat, 8), first) <= 1);
+    EXPECT_TRUE(stats, diff(shade(GTileMode::kRepeat, 16), first) <= 1);
+    EXPECT_TRUE(stats, diff(shade(GTileMode::kRepeat, -8), first) <= 1);
+    EXPECT_TRUE(stats, diff(shade(GTileMode::kMirror, 8), last) <= 1);
+    EXPECT_TRUE(stats, diff(shade(GTileMode::kMirror, 16), first) <= 1);
+    EXPECT_TRUE(stats, diff(shade(GTileMode::kMirror, -8), last) <= 1);
+    EXPECT_EQ(stats, shade(GTileMode::kClamp, 0), first);
+    EXPECT_EQ(stats, shade(GTileMode::kClamp, 8), last);
+}
+
+static void test_shader_invariance(GTestStats* stats) {
+    const GColor colors[] = {{1, 0, 0, 1}, {0, 1, 0, 0.5f}, {0, 0, 1, 1}};
+
+    // hides the shader's invariance, so the canvas shades every pixel of every row
+    struct Varying : GSingleContextShader {
+        GShader* fShader;
+        std::optional<GArena> fArena;
+        GShader::Context* fContext = nullptr;
+        explicit Varying(GShader* shader) : fShader(shader) {}
+        bool isOpaque() override { return fShader->isOpaque(); }
+        bool setContext(const GMatrix& ctm) override {
+            fContext = fShader->makeContext(ctm, fArena.emplace());
+            return fContext != nullptr;
+        }
+        void shadeRow(int x, int y, int count, GPixel row[]) override { fContext->shadeRow(x, y, count, row); }
+    };
+
+    auto horizontal = GCreateLinearGradient({10, 0}, {90, 0}, colors, 3);
+    auto vertical = GCreateLinearGradient({0, 50}, {0, 5}, colors, 3);
+    auto diagonal = GCreateLinearGradient({0, 0}, {90, 60}, colors, 3);
+    auto solid = GCreateLinearGradient({0, 0}, {90, 60}, colors, 1);
+
+    GArena arena;
+    auto invariance = [&](GShader* shader, const GMatrix& ctm) {
+        GShader::Context* ctx = shader->makeContext(ctm, arena);
+        EXPECT_TRUE(stats, ctx != nullptr);
+        return ctx ? ctx->invariance() : -1;
+    };
+    EXPECT_EQ(stats, invariance(horizontal.get(), GMatrix::Translate(3, 7)), (int) GShader::kYInvariant);
+    EXPECT_EQ(stats, invariance(vertical.get(), GMatrix::Scale(2, 0.5f)), (int) GShader::kXInvariant);
+    EXPECT_EQ(stats, invariance(diagonal.get(), GMatrix()), (int) GShader::kVaries);
+    EXPECT_EQ(stats, invariance(horizontal.get(), GMatrix::Rotate(0.3f)), (int) GShader::kVaries);
+    EXPECT_EQ(stats, invariance(solid.get(), GMatrix()), (int) (GShader::kXInvariant | GShader::kYInvariant));
+
+    // spans of a triangle start and end all over, so repeated rows are sliced and extended as they go
+    GPath tri;
+    tri.moveTo({50, 2});
+    tri.lineTo({98, 58});
+    tri.lineTo({4, 40});
+
+    GBitmap a, b;
+    a.alloc(100, 60);
+    b.alloc(100, 60);
+    auto ca = GCreateCanvas(a), cb = GCreateCanvas(b);
+
+    bool close = true;
+    for (GShader* shader: {horizontal.get(), vertical.get(), solid.get()}) {
+        for (GBlendMode mode: {GBlendMode::kSrc, GBlendMode::kSrcOver, GBlendMode::kDstIn, GBlendMode::kXor}) {
+            Varying varying(shader);
+            for (auto* canvas: {ca.get(), cb.get()}) {
+                canvas->clear({0.2f, 0.4f, 0.6f, 0.8f});
+                canvas->save();
+                canvas->translate(1, 2);
+            }
+
+            GPaint paint(shader), plain(&varying);
+            paint.setBlendMode(mode);
+            plain.setBlendMode(mode);
+            ca->drawPath(tri, paint);
+            cb->drawPath(tri, plain);
+            ca->drawRect(GRect::XYWH(5, 5, 60, 20), paint);
+            cb->drawRect(GRect::XYWH(5, 5, 60, 20), plain);
+
+            ca->restore();
+            cb->restore();
+            close &= max_channel_diff(a, b) <= 1;
+        }
+    }
+    EXPECT_TRUE(stats, close);
+
+    free(a.pixels());
+    free(b.pixels());
+}
+
+static void test_shader_constants(GTestStats* stats) {
+    const GColor opaque[] = {{1, 0, 0, 1}, {0, 1, 0, 1}, {0, 0, 1, 1}};
+    const GColor clear[] = {{1, 0, 0, 1}, {0, 1, 0, 0.5f}, {0, 0, 1, 1}};
+    const GColor same[] = {{0.2f, 0.6f, 1, 0.4f}, {0.2f, 0.6f, 1, 0.4f}, {0.2f, 0.6f, 1, 0.4f}};
+    const GPoint pts[] = {{0, 0}, {40, 5}, {10, 30}};
+
+    EXPECT_TRUE(stats, GCreateLinearGradient({0, 0}, {9, 4}, opaque, 3)->isOpaque());
+    EXPECT_FALSE(stats, GCreateLinearGradient({0, 0}, {9, 4}, clear, 3)->isOpaque());
+    EXPECT_TRUE(stats, GCreateTriangleGradient(pts, opaque)->isOpaque());
+    EXPECT_FALSE(stats, GCreateTriangleGradient(pts, clear)->isOpaque());
+
+    const GPixel same_pixel = GPixel_PackARGB(GRoundToInt(0.4f * 255), GRoundToInt(0.4f * 0.2f * 255),
+                                              GRoundToInt(0.4f * 0.6f * 255), GRoundToInt(0.4f * 255));
+
+    auto constant = [](GShader* shader) {
+        GArena arena;
+        GShader::Context* ctx = shader->makeContext(GMatrix::Rotate(0.4f), arena);
+        return ctx ? ctx->constantColor() : std::nullopt;
+    };
+    EXPECT_TRUE(stats, constant(GCreateLinearGradient({0, 0}, {9, 4}, same, 3).get()) == same_pixel);
+    EXPECT_TRUE(stats, constant(GCreateLinearGradient({0, 0}, {9, 4}, opaque, 1).get()).has_value());
+    EXPECT_FALSE(stats, constant(GCreateLinearGradient({0, 0}, {9, 4}, opaque, 2).get()).has_value());
+    EXPECT_TRUE(stats, constant(GCreateTriangleGradient(pts, same).get()) == same_pixel);
+    EXPECT_FALSE(stats, constant(GCreateTriangleGradient(pts, opaque).get()).has_value());
+
+    GBitmap one, tex;
+    one.alloc(1, 1);
+    *one.getAddr(0, 0) = GPixel_PackARGB(200, 10, 150, 200);
+    tex.alloc(6, 5);
+    visit_pixels(tex, [](int x, int y, GPixel* p) { *p = GPixel_PackARGB(255 - x * 9, x * 30, y * 40, 0); });
+
+    auto one_shader = GCreateBitmapShader(one, GMatrix::Scale(3, 3), GTileMode::kMirror);
+    EXPECT_TRUE(stats, constant(one_shader.get()) == *one.getAddr(0, 0));
+
+    // a compose with one single colored child shades only the other, but comes out the same as modulating both
+    auto white_tri = GCreateTriangleGradient(pts, std::vector<GColor>(3, {1, 1, 1, 1}).data());
+    auto same_tri = GCreateTriangleGradient(pts, same);
+    auto varying_tri = GCreateTriangleGradient(pts, clear);
+    auto tex_shader = GCreateBitmapShader(tex, GMatrix::Scale(5, 4), GTileMode::kRepeat);
+    auto proxy = GCreateProxyShader(*tex_shader, GMatrix::Translate(1, 2));
+
+    bool matches = true;
+    for (GShader* tri: {white_tri.get(), same_tri.get(), varying_tri.get()}) {
+        auto compose = GCreateTriangleCompose(*tri, *proxy);
+        GArena arena;
+        GShader::Context* compose_ctx = compose->makeContext(GMatrix(), arena);
+        GShader::Context* tri_ctx = tri->makeContext(GMatrix(), arena);
+        GShader::Context* proxy_ctx = proxy->makeContext(GMatrix(), arena);
+        EXPECT_TRUE(stats, compose_ctx && tri_ctx && proxy_ctx);
+        EXPECT_FALSE(stats, compose_ctx->constantColor().has_value());
+
+        for (int y = 0; y < 30; y += 4) {
+            const int N = 40;
+            GPixel got[N], a[N], b[N];
+            compose_ctx->shadeRow(0, y, N, got);
+            tri_ctx->shadeRow(0, y, N, a);
+            proxy_ctx->shadeRow(0, y, N, b);
+
+            for (int i = 0; i < N; i++) {
+                GPixel want = GPixel_PackARGB(gutils::divBy255(GPixel_GetA(a[i]) * GPixel_GetA(b[i])),
+                                              gutils::divBy255(GPixel_GetR(a[i]) * GPixel_GetR(b[i])),
+                                              gutils::divBy255(GPixel_GetG(a[i]) * GPixel_GetG(b[i])),
+                                              gutils::divBy255(GPixel_GetB(a[i]) * GPixel_GetB(b[i])));
+                matches &= got[i] == want;
+            }
+        }
+    }
+    EXPECT_TRUE(stats, matches);
+
+    auto one_proxy = GCreateProxyShader(*one_shader, GMatrix());
+    auto both = GCreateTriangleCompose(*same_tri, *one_proxy);
+    EXPECT_TRUE(stats, constant(both.get()).has_value());
+
+    // a single colored shader draws exactly like a paint of that color
+    GBitmap a, b;
+    a.alloc(50, 40);
+    b.alloc(50, 40);
+    auto ca = GCreateCanvas(a), cb = GCreateCanvas(b);
+    auto same_gradient = GCreateLinearGradient({0, 0}, {9, 4}, same, 3);
+    for (GBlendMode mode: {GBlendMode::kSrc, GBlendMode::kSrcOver, GBlendMode::kDstOut}) {
+        ca->clear({0.5f, 0.1f, 0.3f, 0.9f});
+        cb->clear({0.5f, 0.1f, 0.3f, 0.9f});
+
+        GPaint shaded(same_gradient.get()), solid(same[0]);
+        shaded.setBlendMode(mode);
+        solid.setBlendMode(mode);
+        ca->drawConvexPolygon(pts, 3, shaded);
+        cb->drawConvexPolygon(pts, 3, solid);
+        EXPECT_EQ(stats, max_channel_diff(a, b), 0);
+    }
+
+    free(one.pixels());
+    free(tex.pixels());
+    free(a.pixels());
+    free(b.pixels());
+}
+
+static void test_shade_spans(GTestStats* stats) {
+    GBitmap tex;
+    tex.alloc(13, 9);
+    visit_pixels(tex, [](int x, int y, GPixel* p) { *p = GPixel_PackARGB(255, x * 19, y * 28, (x * y) & 255); });
+
+    const GColor colors[] = {{1, 0, 0, 1}, {0, 1, 0, 0.5f}, {0, 0, 1, 1}};
+    const GPoint pts[] = {{2, 3}, {60, 10}, {20, 45}};
+
+    auto translated = GCreateBitmapShader(tex, GMatrix::Translate(-3, 5), GTileMode::kRepeat);
+    auto scaled = GCreateBitmapShader(tex, GMatrix::Scale(2.5f, 1.5f), GTileMode::kMirror);
+    auto rotated = GCreateBitmapShader(tex, GMatrix::Rotate(0.5f), GTileMode::kRepeat, GMipmapMode::kNone,
+                                       GTextureLayout::kTiled);
+    auto gradient = GCreateLinearGradient({5, 5}, {50, 30}, colors, 3);
+    auto repeating = GCreateLinearGradient({5, 5}, {12, 9}, colors, 3, GTileMode::kMirror);
+    auto tri = GCreateTriangleGradient(pts, colors);
+    auto proxy = GCreateProxyShader(*rotated, GMatrix::Scale(2, 2));
+    auto compose = GCreateTriangleCompose(*tri, *proxy);
+
+    // spans of all lengths, out of order and repeated, batched into one buffer
+    const int N = 12;
+    const int xs[N] = {0, 7, -4, 20, 3, 3, 31, 0, 11, -9, 2, 40};
+    const int ys[N] = {0, 1, 2, 3, 9, 9, 5, 40, 17, -6, 22, 8};
+    const int counts[N] = {1, 2, 3, 30, 5, 5, 17, 64, 9, 12, 1, 7};
+
+    bool same = true;
+    for (GShader* shader: {translated.get(), scaled.get(), rotated.get(), gradient.get(), repeating.get(),
+                           tri.get(), proxy.get(), compose.get()}) {
+        GArena arena;
+        GShader::Context* ctx = shader->makeContext(GMatrix::Translate(1, 2), arena);
+        EXPECT_TRUE(stats, ctx != nullptr);
+
+        GPixel batched[256], single[256];
+        GShader::Span spans[N];
+        int used = 0;
+        for (int i = 0; i < N; i++) {
+            spans[i] = {xs[i], ys[i], counts[i], batched + used};
+            ctx->shadeRow(xs[i], ys[i], counts[i], single + used);
+            used += counts[i];
+        }
+
+        ctx->shadeSpans(spans, N);
+        same &= std::equal(batched, batched + used, single);
+    }
+    EXPECT_TRUE(stats, same);
+
+    // a band passes on only its own rows' spans, whether a batch is wholly inside it or not
+    GCountingBlitter counter;
+    GBandBlitter band(2, 6, &counter);
+    const GSpan inside[] = {{0, 2, 4}, {1, 3, 5}, {2, 5, 6}};
+    const GSpan across[] = {{0, 1, 4}, {1, 3, 5}, {2, 6, 6}, {3, 4, 1}};
+    band.blitSpans(inside, 3);
+    band.blitSpans(across, 4);
+    EXPECT_EQ(stats, counter.spans(), (int64_t) 5);
+    EXPECT_EQ(stats, counter.pixels(), (int64_t) 21);
+
+    free(tex.pixels());
+}
+
+static void test_shader_contexts(GTestStats* stats) {
+    GBitmap tex;
+    tex.alloc(64, 48);
+    visit_pixels(tex, [](int x, int y, GPixel* p) { *p = GPixel_PackARGB(255, x * 4, y * 5, (x ^ y) * 3); });
+
+    const GColor colors[] = {{1, 0, 0, 1}, {0, 1, 0, 0.5f}, {0, 0, 1, 1}};
+    // big enough to hold every pixel shaded below, as a triangle's colors are only valid inside it
+    const GPoint pts[] = {{-400, -400}, {900, -300}, {-300, 800}};
+
+    auto make_shaders = [&]() {
+        std::vector<std::unique_ptr<GShader>> shaders;
+        shaders.push_back(GCreateBitmapShader(tex, GMatrix::Rotate(0.3f), GTileMode::kMirror, GMipmapMode::kNearest,
+                                              GTextureLayout::kTiled));
+        shaders.push_back(GCreateLinearGradient({0, 0}, {40, 25}, colors, 3, GTileMode::kRepeat));
+        shaders.push_back(GCreateTriangleGradient(pts, colors));
+        shaders.push_back(GCreateProxyShader(*shaders[0], GMatrix::Scale(0.5f, 0.5f)));
+        shaders.push_back(GCreateTriangleCompose(*shaders[2], *shaders[3]));
+        return shaders;
+    };
+
+    // shrinking by 5 draws from a halving, which the first such draw builds
+    const int M = 4;
+    const GMatrix ctms[M] = {GMatrix(), GMatrix::Scale(0.2f, 0.3f), GMatrix::Translate(7, -3) * GMatrix::Rotate(1.1f),
+                             GMatrix::Scale(3, 2)};
+
+    // contexts of one shader under different ctms, shaded in turn, each shade as if it were the only one
+    auto shaders = make_shaders();
+    bool same = true;
+    for (auto& shader: shaders) {
+        GArena arena;
+        GShader::Context* contexts[M];
+        for (int k = 0; k < M; k++) {
+            contexts[k] = shader->makeContext(ctms[k], arena);
+            EXPECT_TRUE(stats, contexts[k] != nullptr);
+        }
+
+        const int N = 50;
+        for (int y = -4; y < 40; y += 5) {
+            for (int k = 0; k < M; k++) {
+                GPixel got[N], want[N];
+                contexts[k]->shadeRow(-5, y, N, got);
+
+                auto fresh = make_shaders();
+                GShader* alone = fresh[&shader - &shaders[0]].get();
+                GArena alone_arena;
+                GShader::Context* alone_ctx = alone->makeContext(ctms[k], alone_arena);
+                EXPECT_TRUE(stats, alone_ctx != nullptr);
+                alone_ctx->shadeRow(-5, y, N, want);
+                same &= std::equal(got, got + N, want);
+            }
+        }
+    }
+    EXPECT_TRUE(stats, same);
+
+    // one set of shaders drawn by several threads at once comes out as it does drawn by one
+    auto draw = [&](const std::vector<std::unique_ptr<GShader>>& with, int i, GBitmap& bm) {
+        auto canvas = GCreateCanvas(bm);
+        canvas->clear({1, 1, 1, 1});
+        canvas->concat(ctms[i % M]);
+
+        GPaint paint(with[i % with.size()].get());
+        canvas->drawRect(GRect::XYWH(-20, -20, 120, 120), paint);
+    };
+
+    const int J = 20;
+    std::vector<GBitmap> serial(J), threaded(J);
+    for (int i = 0; i < J; i++) {
+        serial[i].alloc(48, 40);
+        threaded[i].alloc(48, 40);
+        draw(make_shaders(), i, serial[i]);
+    }
+
+    auto shared = make_shaders();
+    GThreadPool pool(3);
+    pool.parallelFor(J, [&](int i) { draw(shared, i, threaded[i]); });
+
+    for (int i = 0; i < J; i++) {
+        EXPECT_EQ(stats, max_channel_diff(serial[i], threaded[i]), 0);
+        free(serial[i].pixels());
+        free(threaded[i].pixels());
+    }
+
+    free(tex.pixels());
+}
@@ -0,0 +1,33 @@
+/**
+ *  Copyright 2024 Aruj Bansal
+ */
+
+#ifndef GTestUtils_DEFINED
+#define GTestUtils_DEFINED
+
+#include "../include/GBitmap.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+// The largest difference between any channel of two same sized bitmaps
+static int max_channel_diff(const GBitmap& a, const GBitmap& b) {
+    int diff = 0;
+    visit_pixels(a, [&](int x, int y, GPixel* p) {
+        GPixel q = *b.getAddr(x, y);
+        diff = std::max({diff, std::abs(GPixel_GetA(*p) - GPixel_GetA(q)), std::abs(GPixel_GetR(*p) - GPixel_GetR(q)),
+                         std::abs(GPixel_GetG(*p) - GPixel_GetG(q)), std::abs(GPixel_GetB(*p) - GPixel_GetB(q))});
+    });
+    return diff;
+}
+
+// The number of pixels that are not transparent black
+static int count_pixels(const GBitmap& bm) {
+    int count = 0;
+    visit_pixels(bm, [&](int x, int y, GPixel* p) {
+        count += *p != 0;
+    });
+    return count;
+}
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ *  Copyright 2024 Aruj Bansal
+ */
+
+#ifndef GArena_h_DEFINED
+#define GArena_h_DEFINED
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ *  Scratch memory for the objects a single draw sets up (its blitter, shading state, ...). Objects are bump
+ *  allocated from an inline block, so a draw that stays within it never touches the heap, and they are all
+ *  destroyed together, in reverse order, when the arena goes away.
+ */
+class GArena {
+public:
+    GArena() : fCursor(fInline), fEnd(fInline + kInlineBytes) {}
+
+    ~GArena() {
+        for (Cleanup *cleanup = fCleanups; cleanup != nullptr; cleanup = cleanup->next)
+            cleanup->destroy(cleanup->object);
+    }
+
+    GArena(const GArena &) = delete;
+
+    GArena &operator=(const GArena &) = delete;
+
+    template<typename T, typename... Args>
+    T *make(Args &&... args) {
+        T *object = new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            auto destroy = [](void *p) { static_cast<T *>(p)->~T(); };
+            fCleanups = new(allocate(sizeof(Cleanup), alignof(Cleanup))) Cleanup{destroy, object, fCleanups};
+        }
+
+        return object;
+    }
+
+    /**
+     *  Uninitialized room for count T's, which must not need destroying.
+     */
+    template<typename T>
+    T *makeArray(size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>);
+        return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+private:
+    enum {
+        kInlineBytes = 512,
+        kMinBlockBytes = 4096,
+    };
+
+    struct Cleanup {
+        void (*destroy)(void *);
+
+        void *object;
+        Cleanup *next;
+    };
+
+    void *allocate(size_t size, size_t align) {
+        auto aligned = [align](char *p) {
+            return reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(p) + align - 1) & ~(uintptr_t) (align - 1));
+        };
+
+        char *start = aligned(fCursor);
+        if (start + size > fEnd) {
+            size_t block_bytes = std::max<size_t>(kMinBlockBytes, size + align);
+            fBlocks.emplace_back(new char[block_bytes]);
+            fEnd = fBlocks.back().get() + block_bytes;
+            start = aligned(fBlocks.back().get());
+        }
+
+        fCursor = start + size;
+        return start;
+    }
+
+    alignas(std::max_align_t) char fInline[kInlineBytes];
+    char *fCursor;
+    char *fEnd;
+    Cleanup *fCleanups = nullptr;
+    std::vector<std::unique_ptr<char[]>> fBlocks;
+};
+
+#endif
@@ -4,11 +4,11 @@
 #include "GPoint.h"
 
 namespace bezier {
-    inline GPoint eval_quad(float t, GPoint points[3]) {
+    inline GPoint eval_quad(float t, const GPoint points[3]) {
         return (points[0] * (1 - t) * (1 - t)) + (2 * points[1] * t * (1 - t)) + (points[2] * t * t);
     }
 
-    inline GPoint eval_cubic(float t, GPoint points[4]) {
+    inline GPoint eval_cubic(float t, const GPoint points[4]) {
         return (points[0] * (1 - t) * (1 - t) * (1 - t)) + (3 * points[1] * t * (1 - t) * (1 - t)) +
                (3 * points[2] * (1 - t) * t * t) + (points[3] * t * t * t);
     }
@@ -25,10 +25,17 @@ namespace bezier {
 
     inline std::pair<float, float> derivative_zero_cubic(float a, float b, float c, float d) {
         float term3 = (d - a + 3 * b - 3 * c);
-        if (term3 == 0)
-            return {-1.0f, -1.0f};
-
         float term1 = (-1 * a + 2 * b - c);
+
+        // The derivative degenerates to a line, which has at most one root
+        if (term3 == 0) {
+            if (term1 == 0)
+                return {-1.0f, -1.0f};
+
+            float t = (a - b) / (-2 * term1);
+            return {t, t};
+        }
+
         float term2 = std::sqrt(b * b - d * b - b * c + d * a + c * c - a * c);
 
         float t1 = (term1 + term2) / term3;
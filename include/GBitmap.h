@@ -62,6 +62,12 @@ public:
      */
     bool readFromFile(const char path[]);
 
+    /**
+     *  Same as readFromFile(), but reads the png image from the size bytes at data (e.g. a file that has been
+     *  loaded or mapped into memory), which are left untouched.
+     */
+    bool readFromMemory(const void* data, size_t size);
+
     /*
      *  Attempt to write the bitmap as a PNG into a new file (the file will be created/overwritten).
      *  Return true on success.
@@ -0,0 +1,114 @@
+/*
+ *  Copyright 2024 Aruj Bansal
+ */
+
+#ifndef GBlitter_h_DEFINED
+#define GBlitter_h_DEFINED
+
+#include "GArena.h"
+#include "GBitmap.h"
+#include "GMatrix.h"
+#include "GPaint.h"
+#include "GRect.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ *  The w pixels [x, x + w) of row y.
+ */
+struct GSpan {
+    int x, y, w;
+};
+
+/**
+ *  Receives the spans a rasterizer produces. Rasterizers only decide which pixels a shape covers; what happens to
+ *  them (blending a color or a shader into the device, recording a mask, counting) is up to the blitter.
+ *
+ *  Spans handed to a blitter are never empty, and always lie inside the area being rasterized into.
+ */
+class GBlitter {
+public:
+    virtual ~GBlitter() = default;
+
+    /**
+     *  Blit the w pixels [x, x + w) of row y.
+     */
+    virtual void blitH(int x, int y, int w) = 0;
+
+    /**
+     *  Blit the w x h pixels whose top left corner is (x, y). By default this is blitH on each row.
+     */
+    virtual void blitRect(int x, int y, int w, int h);
+
+    /**
+     *  Blit count spans, in any order. Rasterizers that produce spans a few at a time hand them over together,
+     *  so that a blitter can share its setup between them. By default this is blitH on each.
+     */
+    virtual void blitSpans(const GSpan spans[], int count);
+
+    /**
+     *  Return the blitter that draws paint into device under the ctm, allocated from arena. Returns nullptr if
+     *  the paint can not draw anything (e.g. its shader can not handle the ctm).
+     */
+    static GBlitter *Choose(const GBitmap &device, const GPaint &paint, const GMatrix &ctm, GArena &arena);
+};
+
+/**
+ *  Records which pixels inside its bounds are covered, as one byte per pixel (0 or 255).
+ */
+class GMaskBlitter : public GBlitter {
+public:
+    explicit GMaskBlitter(const GIRect &bounds);
+
+    void blitH(int x, int y, int w) override;
+
+    const GIRect &bounds() const { return fBounds; }
+
+    uint8_t coverage(int x, int y) const;
+
+private:
+    GIRect fBounds;
+    std::vector<uint8_t> fMask;
+};
+
+/**
+ *  Counts the spans and pixels it is handed, passing them on to another blitter if one is given.
+ */
+class GCountingBlitter : public GBlitter {
+public:
+    explicit GCountingBlitter(GBlitter *next = nullptr) : fNext(next) {}
+
+    void blitH(int x, int y, int w) override;
+
+    void blitRect(int x, int y, int w, int h) override;
+
+    int64_t spans() const { return fSpans; }
+
+    int64_t pixels() const { return fPixels; }
+
+private:
+    GBlitter *fNext;
+    int64_t fSpans = 0;
+    int64_t fPixels = 0;
+};
+
+/**
+ *  Passes on only the spans in rows [top, bottom), whole, to another blitter.
+ */
+class GBandBlitter : public GBlitter {
+public:
+    GBandBlitter(int top, int bottom, GBlitter *next) : fTop(top), fBottom(bottom), fNext(next) {}
+
+    void blitH(int x, int y, int w) override;
+
+    void blitRect(int x, int y, int w, int h) override;
+
+    void blitSpans(const GSpan spans[], int count) override;
+
+private:
+    int fTop, fBottom;
+    GBlitter *fNext;
+};
+
+#endif
@@ -10,74 +10,25 @@
 #include "GBitmap.h"
 #include "GPath.h"
 #include "GPaint.h"
-#include "GBlender.h"
 #include "GEdge.h"
 #include "GMatrix.h"
 
 #include <array>
+#include <memory>
 #include <stack>
+#include <vector>
 
-using BlendProc = GPixel (*)(GPixel, GPixel);
-using BlitzProc = void (*)(int, int, int, const GBitmap &, const GPixel *);
+class GArena;
 
-template<bool has_shader>
-struct BlitRow {
-    template<BlendProc blend_function>
-    static void blit_row(int x1, int x2, int y, const GBitmap &device, const GPixel row[]) {
-        for (int x = x1; x < x2; x++) {
-            GPixel *dst = device.getAddr(x, y);
+class GBlitter;
 
-            if (has_shader) *dst = blend_function(row[x - x1], *dst);
-            else *dst = blend_function(row[0], *dst);
-        }
-    }
+class GRegion;
 
-    constexpr static const BlitzProc normal_blend[12] = {blit_row<GBlender::kClear>,
-                                                         blit_row<GBlender::kSrc>,
-                                                         blit_row<GBlender::kDst>,
-                                                         blit_row<GBlender::kSrcOver>,
-                                                         blit_row<GBlender::kDstOver>,
-                                                         blit_row<GBlender::kSrcIn>,
-                                                         blit_row<GBlender::kDstIn>,
-                                                         blit_row<GBlender::kSrcOut>,
-                                                         blit_row<GBlender::kDstOut>,
-                                                         blit_row<GBlender::kSrcATop>,
-                                                         blit_row<GBlender::kDstATop>,
-                                                         blit_row<GBlender::kXor>};
-
-    constexpr static const BlitzProc blend255[12] = {blit_row<GBlender::kClear>,
-                                                     blit_row<GBlender::kSrc>,
-                                                     blit_row<GBlender::kDst>,
-                                                     blit_row<GBlender::kSrc>,
-                                                     blit_row<GBlender::kDstOver>,
-                                                     blit_row<GBlender::kSrcIn>,
-                                                     blit_row<GBlender::kDst>,
-                                                     blit_row<GBlender::kSrcOut>,
-                                                     blit_row<GBlender::kClear>,
-                                                     blit_row<GBlender::kSrcIn>,
-                                                     blit_row<GBlender::kDstOver>,
-                                                     blit_row<GBlender::kSrcOut>};
-
-
-    constexpr static const BlitzProc blend0[12] = {blit_row<GBlender::kClear>,
-                                                   blit_row<GBlender::kClear>,
-                                                   blit_row<GBlender::kDst>,
-                                                   blit_row<GBlender::kDst>,
-                                                   blit_row<GBlender::kDst>,
-                                                   blit_row<GBlender::kClear>,
-                                                   blit_row<GBlender::kClear>,
-                                                   blit_row<GBlender::kClear>,
-                                                   blit_row<GBlender::kDst>,
-                                                   blit_row<GBlender::kDst>,
-                                                   blit_row<GBlender::kClear>,
-                                                   blit_row<GBlender::kDst>};
-};
+class GThreadPool;
 
 class GCanvas {
 public:
-    explicit GCanvas(const GBitmap &device) : fDevice(device) {
-        transformations.emplace();
-    }
+    explicit GCanvas(const GBitmap &device);
 
     void save();
 
@@ -85,22 +36,62 @@ public:
 
     void concat(const GMatrix &matrix);
 
+    /**
+     *  Fill every pixel of the device with color, ignoring the clip.
+     */
     void clear(const GColor &color);
 
+    /**
+     *  Intersect the clip with the rect, or the path, mapped by the CTM. Pixels are kept when their centers
+     *  are inside. Like the CTM, the clip is saved and restored by save() and restore().
+     */
+    void clipRect(const GRect &);
+
+    void clipPath(const GPath &);
+
+    /**
+     *  Return the device space bounds of the clip. Nothing outside of them is drawn.
+     */
+    GIRect getClipBounds() const;
+
     void drawRect(const GRect &rect, const GPaint &paint);
 
     void drawConvexPolygon(const GPoint[], int count, const GPaint &);
 
+    /**
+     *  Draw a one pixel wide (hairline) segment from p0 to p1. The width does not scale with the CTM.
+     */
+    void drawLine(GPoint p0, GPoint p1, const GPaint &);
+
     void drawPath(const GPath &, const GPaint &);
 
-    template<bool, int>
-    void drawPath(std::vector<Edge> &, const GPaint &);
+    /**
+     *  Rasterize the path under the CTM, handing the spans it covers to blitter instead of drawing them.
+     */
+    void drawPath(const GPath &, GBlitter &blitter);
+
+    /**
+     *  Fill the circle, the oval inscribed in rect, or the rect with elliptical corners of radii rx, ry.
+     *  Under a scale/translate CTM each row's span is computed directly from the ellipse, instead of
+     *  flattening curves into edges.
+     */
+    void drawCircle(GPoint center, float radius, const GPaint &);
+
+    void drawOval(const GRect &rect, const GPaint &);
+
+    void drawRRect(const GRect &rect, float rx, float ry, const GPaint &);
 
     void drawMesh(const GPoint verts[], const GColor colors[], const GPoint texs[], int count, const int indices[],
                   const GPaint &);
 
     void drawQuad(const GPoint verts[4], const GColor colors[4], const GPoint texs[4], int level, const GPaint &);
 
+    /**
+     *  Large draws (e.g. meshes of many triangles) are split across the threads of pool, which must outlive the
+     *  canvas. By default this is GThreadPool::Default(). Results are the same whatever the pool.
+     */
+    void setThreadPool(GThreadPool *pool) { fPool = pool; }
+
     // Helpers
     void translate(float x, float y) {
         this->concat(GMatrix::Translate(x, y));
@@ -124,8 +115,38 @@ public:
     }
 
 public:
+    struct ClipState {
+        // Nothing outside of the bounds is rasterized
+        GIRect bounds;
+        // If set, only pixels in the region (which lies within the bounds) are drawn
+        std::shared_ptr<const GRegion> region;
+    };
+
     const GBitmap fDevice;
     std::stack<GMatrix> transformations;
+    std::stack<ClipState> clips;
+
+private:
+    void setClip(GRegion &&);
+
+    // True if nothing inside the device space bounds can be drawn
+    bool quickReject(const GRect &deviceBounds) const;
+
+    // The blitter for the paint, restricted to the clip; nullptr if nothing can be drawn
+    GBlitter *chooseBlitter(const GPaint &, GArena &);
+
+    GBlitter *clipBlitter(GBlitter *, GArena &);
+
+    void scanPath(const GPath &, GBlitter &);
+
+    GThreadPool *fPool;
+
+    // drawQuad's lattice, kept between calls: the triangle indices for fQuadLevel, and scratch for the points
+    int fQuadLevel = -1;
+    std::vector<int> fQuadIndices;
+    std::vector<GPoint> fQuadVerts;
+    std::vector<GColor> fQuadColors;
+    std::vector<GPoint> fQuadTexs;
 };
 
 /**
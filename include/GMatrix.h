@@ -67,6 +67,16 @@ public:
      */
     void mapPoints(GPoint dst[], const GPoint src[], int count) const;
 
+    /**
+     *  Return the bounds of the four corners of rect after mapping them by this matrix.
+     */
+    GRect mapRect(const GRect &rect) const;
+
+    /**
+     *  Return true if the matrix only scales and translates, so axis-aligned rects stay axis-aligned.
+     */
+    bool isScaleTranslate() const;
+
     // These helper methods are implemented in terms of the previous methods.
     friend GMatrix operator*(const GMatrix &a, const GMatrix &b);
 
@@ -1,31 +1,52 @@
 #ifndef GPath_DEFINED
 #define GPath_DEFINED
 
+#include <atomic>
+#include <memory>
+#include <optional>
 #include <vector>
 #include "GMatrix.h"
 #include "GPoint.h"
 #include "GRect.h"
 
+/**
+ *  Points and verbs live in a shared, reference counted storage block. Copying a path only shares
+ *  the block; the first mutation through a path that does not own its block exclusively makes a
+ *  private copy (copy-on-write). This keeps paths cheap to hand around and capture.
+ */
 class GPath {
 public:
     GPath();
 
     ~GPath();
 
+    GPath(const GPath &);
+
+    GPath(GPath &&) noexcept;
+
     GPath &operator=(const GPath &);
 
+    GPath &operator=(GPath &&) noexcept;
+
     /**
      *  Erase any previously added points/verbs, restoring the path to its initial empty state.
      */
     void reset();
 
+    /**
+     *  Make room for at least this many more points and verbs, so that appending them does not
+     *  reallocate.
+     */
+    void reserve(int extraPoints, int extraVerbs);
+
     /**
      *  Start a new contour at the specified coordinate.
      *  Returns a reference to this path.
      */
     void moveTo(GPoint p) {
-        fPts.push_back(p);
-        fVbs.push_back(kMove);
+        Storage &storage = writable();
+        storage.addPoints(&p, 1);
+        storage.fVbs.push_back(kMove);
     }
 
     void moveTo(float x, float y) { this->moveTo({x, y}); }
@@ -36,9 +57,10 @@ public:
      *  Returns a reference to this path.
      */
     void lineTo(GPoint p) {
-        assert(fVbs.size() > 0);
-        fPts.push_back(p);
-        fVbs.push_back(kLine);
+        assert(countVerbs() > 0);
+        Storage &storage = writable();
+        storage.addPoints(&p, 1);
+        storage.fVbs.push_back(kLine);
     }
 
     void lineTo(float x, float y) { this->lineTo({x, y}); }
@@ -76,7 +98,8 @@ public:
 
     /**
      *  Append a new contour to this path with the specified polygon.
-     *  Calling this is equivalent to calling moveTo(pts[0]), lineTo(pts[1..count-1]).
+     *  Calling this is equivalent to calling moveTo(pts[0]), lineTo(pts[1..count-1]), but the
+     *  points are appended in bulk.
      */
     void addPolygon(const GPoint pts[], int count);
 
@@ -86,16 +109,44 @@ public:
      */
     void addCircle(GPoint center, float radius, Direction = kCW_Direction);
 
-    int countPoints() const { return (int) fPts.size(); }
+    int countPoints() const { return fStorage ? (int) fStorage->fPts.size() : 0; }
+
+    int countVerbs() const { return fStorage ? (int) fStorage->fVbs.size() : 0; }
 
     /**
      *  Return the tight bounds of all of the curve and line segments in the path.
      *  Curve segments may need to be chopped at X and Y extrema to compute this correctly.
      *
+     *  The result is computed on first use and cached until the path is next modified.
+     *
      *  If there are no points, returns an empty rect (all zeros)
      */
     GRect bounds() const;
 
+    /**
+     *  Return the bounds of all the points in the path, including curve control points. This
+     *  always contains bounds(), and is kept up to date as points are added.
+     *
+     *  If there are no points, returns an empty rect (all zeros)
+     */
+    GRect controlBounds() const;
+
+    /**
+     *  Return true if the path is a single closed contour that bounds a convex region. Curves are
+     *  judged by their control points, so a convex curve with a concave control polygon is
+     *  reported as not convex.
+     *
+     *  The answer is cached until the path is next modified.
+     */
+    bool isConvex() const;
+
+    /**
+     *  Return true if the path is a single contour tracing the four corners of a non-empty,
+     *  axis-aligned rect (as addRect() makes), optionally closed by a lineTo back to the start.
+     *  If so, the rect and the contour's direction are returned through the optional arguments.
+     */
+    bool isRect(GRect *rect = nullptr, Direction *direction = nullptr) const;
+
     /**
      *  Transform the path in-place by the specified matrix.
      */
@@ -105,7 +156,7 @@ public:
         this->transform(GMatrix::Translate(dx, dy));
     }
 
-    enum Verb {
+    enum Verb : uint8_t {
         kMove,  // returns pts[0] from Iter
         kLine,  // returns pts[0]..pts[1] from Iter and Edger
         kQuad,  // returns pts[0]..pts[2] from Iter and Edger
@@ -138,6 +189,9 @@ public:
      *  Walks the path, returning "edges" only. Thus it does not return kMove, but will return
      *  the final closing "edge" for each contour.
      *
+     *  If constructed with a matrix, the returned points are mapped through it as they are
+     *  produced, so a transformed path can be walked without copying it first.
+     *
      * Typical calling pattern...
      *
      *   GPoint pts[GPath::kMaxNextPoints];
@@ -153,9 +207,14 @@ public:
     public:
         Edger(const GPath &);
 
+        Edger(const GPath &, const GMatrix &);
+
         std::optional<Verb> next(GPoint pts[]);
 
     private:
+        std::optional<Verb> nextEdge(GPoint pts[]);
+
+        std::optional<GMatrix> fMatrix;
         const GPoint *fPrevMove;
         const GPoint *fCurrPt;
         const Verb *fCurrVb;
@@ -182,8 +241,88 @@ public:
     void dump() const;
 
 private:
-    std::vector<GPoint> fPts;
-    std::vector<Verb> fVbs;
+    /**
+     *  A value worked out from the points and verbs the first time it is asked for. Paths that share storage
+     *  may ask from several threads at once: the first to finish computing it keeps it, and any others that
+     *  were computing at the same time just return their own.
+     */
+    template<typename T>
+    class Lazy {
+    public:
+        Lazy() = default;
+
+        Lazy(const Lazy &other) {
+            if (other.fState.load(std::memory_order_acquire) == kReady) {
+                fValue = other.fValue;
+                fState.store(kReady, std::memory_order_relaxed);
+            }
+        }
+
+        Lazy &operator=(const Lazy &) = delete;
+
+        template<typename Compute>
+        T get(Compute &&compute) const {
+            if (fState.load(std::memory_order_acquire) == kReady) return fValue;
+
+            T value = compute();
+            int expected = kUnknown;
+            if (fState.compare_exchange_strong(expected, kStoring, std::memory_order_relaxed)) {
+                fValue = value;
+                fState.store(kReady, std::memory_order_release);
+            }
+            return value;
+        }
+
+        /**
+         *  Forget the value; only for storage that no other path shares.
+         */
+        void reset() { fState.store(kUnknown, std::memory_order_relaxed); }
+
+    private:
+        enum { kUnknown, kStoring, kReady };
+
+        mutable std::atomic<int> fState{kUnknown};
+        mutable T fValue{};
+    };
+
+    struct Storage {
+        std::vector<GPoint> fPts;
+        std::vector<Verb> fVbs;
+
+        // Only meaningful when fPts is non-empty
+        GRect fControlBounds;
+        Lazy<GRect> fTightBounds;
+        Lazy<bool> fIsConvex;
+
+        void addPoints(const GPoint pts[], int count);
+
+        void recomputeControlBounds();
+    };
+
+    /**
+     *  Returns storage that this path owns exclusively, allocating or copying it if needed.
+     */
+    Storage &writable() {
+        if (!fStorage)
+            fStorage = std::make_shared<Storage>();
+        else if (fStorage.use_count() > 1)
+            fStorage = std::make_shared<Storage>(*fStorage);
+
+        // Whoever asked for writable storage is about to change it
+        fStorage->fTightBounds.reset();
+        fStorage->fIsConvex.reset();
+        return *fStorage;
+    }
+
+    GRect computeTightBounds() const;
+
+    bool computeIsConvex() const;
+
+    const GPoint *pointsData() const { return fStorage ? fStorage->fPts.data() : nullptr; }
+
+    const Verb *verbsData() const { return fStorage ? fStorage->fVbs.data() : nullptr; }
+
+    std::shared_ptr<Storage> fStorage;
 };
 
 #endif
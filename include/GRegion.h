@@ -0,0 +1,108 @@
+/*
+ *  Copyright 2024 Aruj Bansal
+ */
+
+#ifndef GRegion_h_DEFINED
+#define GRegion_h_DEFINED
+
+#include "GBlitter.h"
+#include "GRect.h"
+
+#include <vector>
+
+/**
+ *  A set of pixels, stored row by row as sorted, disjoint spans [left, right). Row y's spans are found directly
+ *  from an offset table, so walking a row costs nothing beyond its own spans.
+ */
+class GRegion {
+public:
+    struct Span {
+        int left, right;
+    };
+
+    /**
+     *  The empty region.
+     */
+    GRegion();
+
+    explicit GRegion(const GIRect &rect);
+
+    bool isEmpty() const { return fBounds.isEmpty(); }
+
+    /**
+     *  Return true if the region is exactly its bounds (or empty).
+     */
+    bool isRect() const;
+
+    const GIRect &bounds() const { return fBounds; }
+
+    /**
+     *  The spans of row y, in x order. Rows outside the bounds have none.
+     */
+    const Span *rowBegin(int y) const { return fSpans.data() + rowOffset(y); }
+
+    const Span *rowEnd(int y) const { return fSpans.data() + rowOffset(y + 1); }
+
+    bool contains(int x, int y) const;
+
+    GRegion intersect(const GRegion &) const;
+
+    GRegion unite(const GRegion &) const;
+
+    /**
+     *  Collects the spans of whatever is rasterized into it, in any order, into a region.
+     */
+    class Builder : public GBlitter {
+    public:
+        void blitH(int x, int y, int w) override;
+
+        GRegion detach();
+
+    private:
+        struct RowSpan {
+            int y, left, right;
+        };
+
+        std::vector<RowSpan> fRowSpans;
+    };
+
+private:
+    int rowOffset(int y) const {
+        if (y <= fBounds.top) return 0;
+        if (y >= fBounds.bottom) return (int) fSpans.size();
+        return fRows[y - fBounds.top];
+    }
+
+    // Appends row y's spans, dropping the row if it is empty; rows must be added top to bottom
+    void addRow(int y, const std::vector<Span> &spans);
+
+    // Trims empty rows from the ends and computes the bounds
+    void finish();
+
+    template<typename RowOp>
+    static GRegion Combine(const GRegion &a, const GRegion &b, int top, int bottom, RowOp &&op);
+
+    GIRect fBounds;
+    // fRows[i] is the offset in fSpans of row fBounds.top + i; one extra entry marks the end of the last row
+    std::vector<int> fRows;
+    std::vector<Span> fSpans;
+
+    // Rows added so far, before finish() makes them relative to the bounds
+    std::vector<int> fRowYs;
+};
+
+/**
+ *  Passes on only the parts of each span that lie inside the region.
+ */
+class GRegionBlitter : public GBlitter {
+public:
+    GRegionBlitter(const GRegion &region, GBlitter *next) : fRegion(region), fNext(next) {}
+
+    void blitH(int x, int y, int w) override;
+
+private:
+    const GRegion &fRegion;
+    GBlitter *fNext;
+};
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ *  Copyright 2024 Aruj Bansal
+ */
+
+#ifndef GThreadPool_h_DEFINED
+#define GThreadPool_h_DEFINED
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ *  A fixed set of worker threads for splitting a draw's independent pieces of work (e.g. the row bands of a mesh)
+ *  across cores. The calling thread works alongside the workers, so a pool with no workers just runs everything
+ *  inline.
+ */
+class GThreadPool {
+public:
+    /**
+     *  A pool with count worker threads.
+     */
+    explicit GThreadPool(int count);
+
+    ~GThreadPool();
+
+    GThreadPool(const GThreadPool &) = delete;
+
+    GThreadPool &operator=(const GThreadPool &) = delete;
+
+    /**
+     *  The pool shared by all canvases, with a worker for every core but the caller's.
+     */
+    static GThreadPool &Default();
+
+    /**
+     *  The number of threads that run work, counting the caller.
+     */
+    int threads() const { return (int) fWorkers.size() + 1; }
+
+    /**
+     *  Call fn(i) for every i in [0, count), in no particular order or thread, returning once they have all
+     *  finished. Calls from several threads at once take turns.
+     */
+    void parallelFor(int count, const std::function<void(int)> &fn);
+
+private:
+    // Claim and run indices of job, the current one, until there are none left
+    void work(const std::function<void(int)> &job, int count);
+
+    std::vector<std::thread> fWorkers;
+
+    std::mutex fJobMutex;       // held for the whole of one parallelFor
+    std::mutex fMutex;          // guards the fields below
+    std::condition_variable fWake, fDone;
+
+    const std::function<void(int)> *fJob = nullptr;
+    int fCount = 0;
+    std::atomic<int> fNext{0};
+    int fBusy = 0;              // workers still inside the current job
+    uint64_t fGeneration = 0;   // bumped for every job, so workers never run one twice
+    bool fQuit = false;
+};
+
+#endif
@@ -0,0 +1,26 @@
+/*
+ *  Copyright 2024 Aruj Bansal
+ */
+
+#ifndef GTriangleRasterizer_h_DEFINED
+#define GTriangleRasterizer_h_DEFINED
+
+#include "GBlitter.h"
+#include "GPoint.h"
+#include "GRect.h"
+
+/**
+ *  Scan converts the device space triangle pts into blitter, limited to bounds, by evaluating its three edge
+ *  functions over 8x8 blocks of pixels. Blocks entirely inside or outside the triangle are settled from their
+ *  corners alone; only blocks an edge passes through are tested pixel by pixel. Each row's coverage is handed to
+ *  blitter as one span.
+ *
+ *  A pixel is covered when its center is inside the triangle. Centers exactly on an edge go to the triangle on
+ *  the edge's top or left side, so triangles sharing an edge never both draw, or both skip, a pixel along it.
+ *  Clipping to bounds only removes pixels, it never changes which of the rest are covered.
+ *
+ *  Returns false, drawing nothing, if the corners are too far out for the fixed point edge functions.
+ */
+bool GRasterizeTriangle(const GPoint pts[3], const GIRect &bounds, GBlitter &blitter);
+
+#endif
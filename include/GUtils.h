@@ -46,16 +46,13 @@ namespace gutils {
                                premul_255_float(color.a * color.b));
     }
 
+    /*
+     * Clamps each unpremultiplied channel to [0, 1] before premultiplying, so the color channels never exceed alpha.
+     */
     inline GPixel premul_255_clamp(const GColor color) {
-        float a = std::max(0.0f, std::min(1.0f, color.a));
-        float r = std::max(0.0f, std::min(1.0f, color.a * color.r));
-        float g = std::max(0.0f, std::min(1.0f, color.a * color.g));
-        float b = std::max(0.0f, std::min(1.0f, color.a * color.b));
-
-        return GPixel_PackARGB(premul_255_float(a),
-                               premul_255_float(r),
-                               premul_255_float(g),
-                               premul_255_float(b));
+        auto unit = [](float x) { return std::max(0.0f, std::min(1.0f, x)); };
+
+        return premul_255({unit(color.r), unit(color.g), unit(color.b), unit(color.a)});
     }
 
     inline int mapUnit255(float x) { return GRoundToInt(x * 255); }
@@ -5,30 +5,105 @@
 #include "../../include/GMatrix.h"
 #include "../../include/GBitmap.h"
 
-using TileProc = std::pair<int, int> (*)(int, int, int, int);
+#include <mutex>
+#include <vector>
 
 class MyShader : public GShader {
 public:
-    MyShader(const GBitmap &device, const GMatrix &localMatrix, GTileMode mode);
+    MyShader(const GBitmap &device, const GMatrix &localMatrix, GTileMode mode,
+             GMipmapMode mipmapMode = GMipmapMode::kNone, GTextureLayout layout = GTextureLayout::kRowMajor);
 
     bool isOpaque() override;
 
-    bool setContext(const GMatrix &ctm) override;
+    GShader::Context *makeContext(const GMatrix &ctm, GArena &arena) const override;
 
-    void shadeRow(int x, int y, int count, GPixel row[]) override;
+private:
+    class Context;
 
-    static std::pair<int, int> tile_clamp(int x, int y, int width, int height);
+    // A level's pixels in 8x8 blocks; texel (x, y) is at pixels[columnOffsets[x] + rowOffsets[y]]
+    struct Blocks {
+        std::unique_ptr<GPixel[]> pixels;
+        std::vector<uint32_t> columnOffsets, rowOffsets;
+    };
 
-    static std::pair<int, int> tile_repeat(int x, int y, int width, int height);
+    // A 2x2 box filtered halving of the level above, and with GTextureLayout::kTiled the same in blocks
+    struct Level {
+        std::unique_ptr<GPixel[]> pixels;
+        GBitmap bitmap;
+        Blocks blocks;
+    };
 
-    static std::pair<int, int> tile_mirror(int x, int y, int width, int height);
+    // A copy of bitmap's pixels in 8x8 blocks
+    static Blocks MakeBlocks(const GBitmap &bitmap);
 
+    // Fill fLevels with successive halvings of the bitmap, down to 1x1
+    void buildMipmaps() const;
 
-private:
     GMatrix localMatrix;
-    std::optional<GMatrix> inv;
     GBitmap localBitmap;
-    TileProc tiler{};
+    GTileMode tileMode;
+    GMipmapMode mipmapMode;
+    GTextureLayout textureLayout;
+
+    // With GTextureLayout::kTiled, the bitmap in blocks
+    Blocks fBlocks;
+
+    // Level i + 1 of the pyramid, the bitmap itself being level 0. Built once, by the first draw to need it,
+    // however many threads are drawing
+    mutable std::vector<Level> fLevels;
+    mutable std::once_flag fLevelsBuilt;
+};
+
+/*
+ * One draw of a MyShader: what it samples (the bitmap or one of its halvings, with inv mapping onto it) and how.
+ */
+class MyShader::Context : public GShader::Context {
+public:
+    Context(const GMatrix &inv, const GBitmap &source, const Blocks *sourceBlocks, GTileMode mode);
+
+    void shadeRow(int x, int y, int count, GPixel row[]) override;
+
+    void shadeSpans(const Span spans[], int n) override;
+
+    std::optional<GPixel> constantColor() const override;
+
+private:
+    // How the device maps onto the bitmap, which decides how a row is sampled
+    enum class Sampling {
+        kTranslate,     // one to one: rows are copied out of the bitmap
+        kScale,         // no rotation or skew: every row reads the same columns
+        kAffine,        // anything else: step through the bitmap in fixed point
+    };
+
+    using Sampler = void (Context::*)(int x, int y, int count, GPixel row[]);
+
+    void shadeTranslate(int x, int y, int count, GPixel row[]);
+
+    void shadeScale(int x, int y, int count, GPixel row[]);
+
+    // The sampleAffine for the tile mode and layout
+    Sampler affineSampler() const;
+
+    // v tiled into [0, n) by the tile mode
+    int tile(int v, int n) const;
+
+    // Reads texels from the 8x8 blocks copy of the source if blocks, from its rows otherwise
+    template<GTileMode mode, bool blocks>
+    void sampleAffine(int x, int y, int count, GPixel row[]);
+
+    // The tiled bitmap column of each device column in [x, x + count), for kScale
+    const int *columns(int x, int count);
+
+    GMatrix inv;
+    GBitmap source;
+    // The source in blocks, or null when sampling its rows
+    const Blocks *sourceBlocks;
+    GTileMode tileMode;
+    Sampler sampler = nullptr;
+
+    // columns() cache: fColumns[i] belongs to device column fColumnsLeft + i
+    std::vector<int> fColumns;
+    int fColumnsLeft = 0;
 };
 
 #endif
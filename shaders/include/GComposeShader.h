@@ -14,15 +14,43 @@ public:
 
     bool isOpaque() override;
 
-    bool setContext(const GMatrix &ctm) override;
+    bool isThreadSafe() const override;
 
-    void shadeRow(int x, int y, int count, GPixel row[]) override;
+    GShader::Context *makeContext(const GMatrix &ctm, GArena &arena) const override;
 
 private:
+    class Context;
+
     GShader *gradient_shader;
     GShader *proxy_shader;
 };
 
+/*
+ * One draw of a GComposeShader: a context for each child.
+ */
+class GComposeShader::Context : public GShader::Context {
+public:
+    Context(GShader::Context *gradient, bool gradient_opaque, GShader::Context *proxy, bool proxy_opaque);
+
+    void shadeRow(int x, int y, int count, GPixel row[]) override;
+
+    void shadeSpans(const Span spans[], int n) override;
+
+    int invariance() const override;
+
+    std::optional<GPixel> constantColor() const override;
+
+private:
+    // first is shaded into the row and second alongside it; whichever child is opaque goes second, so the product
+    // keeps first's alpha as it is, and keep_alpha says if so
+    GShader::Context *first, *second;
+    bool keep_alpha;
+
+    // When a child is one color: only the other one is shaded, then scaled by it
+    std::optional<GPixel> child_color;
+    GShader::Context *varying_child = nullptr;
+};
+
 inline std::unique_ptr<GShader> GCreateTriangleCompose(GShader &gradient, GShader &proxy) {
     return std::unique_ptr<GShader>(new GComposeShader(gradient, proxy));
 }
@@ -6,8 +6,7 @@
 #include "../../include/GBitmap.h"
 #include "../../include/GUtils.h"
 
-using GradientTileProc = std::pair<int, float> (*)(float, int);
-
+#include <vector>
 
 class GLinearGradientShader : public GShader {
 public:
@@ -15,27 +14,56 @@ public:
 
     bool isOpaque() override;
 
-    bool setContext(const GMatrix &ctm) override;
-
-    void shadeRow(int x, int y, int count, GPixel row[]) override;
-
-    template<bool>
-    void shadeRow(int x, int y, int count, GPixel row[]);
+    GShader::Context *makeContext(const GMatrix &ctm, GArena &arena) const override;
 
-    static std::pair<int, float> tile_repeat(float x, int num_colors);
+private:
+    class Context;
 
-    static std::pair<int, float> tile_mirror(float x, int num_colors);
+    // Entries in the color table for one pass over the gradient, t in [0, 1)
+    enum {
+        kLutSize = 1024,
+    };
 
-private:
     GMatrix line_mapper;
-    std::optional<GMatrix> inv;
-    std::vector<GColor> colors, colors_diff;
     std::pair<GPixel, GPixel> premul_ends;
     int num_colors;
     GTileMode tile_mode;
-    GradientTileProc tiler{};
+    bool opaque;
+
+    // Set when every color is the same
+    std::optional<GPixel> constant;
+
+    // Premultiplied colors at the middle of each 1/kLutSize of t; for mirror followed by the same in reverse
+    std::vector<GPixel> lut;
 };
 
-#endif
+/*
+ * One draw of a GLinearGradientShader: t at each device pixel, and the table entries it steps by along a row.
+ */
+class GLinearGradientShader::Context : public GShader::Context {
+public:
+    Context(const GLinearGradientShader &shader, const GMatrix &inv);
 
+    void shadeRow(int x, int y, int count, GPixel row[]) override;
 
+    void shadeSpans(const Span spans[], int n) override;
+
+    int invariance() const override;
+
+    std::optional<GPixel> constantColor() const override;
+
+private:
+    // t stepping from one pixel to the next; before 0 and from 1 on are the end colors
+    void shadeClamp(float t, int count, GPixel row[]);
+
+    // t stepping from one pixel to the next, wrapped into one period of the table (there and back for mirror)
+    void shadeTiled(float t, int count, GPixel row[]);
+
+    const GLinearGradientShader &shader;
+    GMatrix inv;
+
+    // The table entries, in 16.16, that t steps by from one pixel of a row to the next
+    int64_t u_step = 0;
+};
+
+#endif
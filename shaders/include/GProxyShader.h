@@ -9,9 +9,10 @@ public:
 
     bool isOpaque() override;
 
-    bool setContext(const GMatrix &ctm) override;
+    bool isThreadSafe() const override;
 
-    void shadeRow(int x, int y, int count, GPixel row[]) override;
+    // The real shader's context, under the extra transform
+    GShader::Context *makeContext(const GMatrix &ctm, GArena &arena) const override;
 
 private:
     GShader *real_shader; // bitmap shader
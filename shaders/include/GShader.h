@@ -2,10 +2,13 @@
 #define GShader_DEFINED
 
 #include <memory>
+#include <optional>
 #include "../../include/GColor.h"
 #include "../../include/GPixel.h"
 #include "../../include/GPoint.h"
 
+class GArena;
+
 class GBitmap;
 
 class GMatrix;
@@ -18,6 +21,11 @@ enum class GTileMode {
 
 /**
  *  GShaders create colors to fill whatever geometry is being drawn to a GCanvas.
+ *
+ *  A draw asks its shader for a Context, which holds whatever the shader works out from the draw's CTM, and
+ *  shades with that. Drawing leaves the shader itself unchanged, so one of them can be drawn by any number of
+ *  canvases and threads at once. (GSingleContextShader is for shaders that would rather keep their context in
+ *  themselves.)
  */
 class GShader {
 public:
@@ -26,23 +34,113 @@ public:
     /// Return true iff all the GPixels that may be returned by this shader will be opaque.
     virtual bool isOpaque() = 0;
 
-    /// The draw calls in GCanvas must call this with the CTM before any calls to shadeSpan().
-    virtual bool setContext(const GMatrix &ctm) = 0;
+    /// Return true iff several draws may shade with this shader at once, i.e. its contexts share no state.
+    virtual bool isThreadSafe() const { return true; }
+
+    /// A row of count pixels in device space from [x, y], to be shaded into row[0...count - 1].
+    struct Span {
+        int x, y, count;
+        GPixel *row;
+    };
+
+    /// Which device axes the shaded colors don't change along, as flags.
+    enum Invariance {
+        kVaries = 0,
+        kXInvariant = 1 << 0,   // every pixel of a row is the same color
+        kYInvariant = 1 << 1,   // every row is the same
+    };
 
     /**
-     *  Given a row of pixels in device space [x, y] ... [x + count - 1, y], return the
-     *  corresponding src pixels in row[0...count - 1]. The caller must ensure that row[]
-     *  can hold at least [count] entries.
+     *  The state for shading one draw. It belongs to that draw, so only one thread shades with it at a time.
      */
+    class Context {
+    public:
+        virtual ~Context() = default;
+
+        /**
+         *  Given a row of pixels in device space [x, y] ... [x + count - 1, y], return the
+         *  corresponding src pixels in row[0...count - 1]. The caller must ensure that row[]
+         *  can hold at least [count] entries.
+         */
+        virtual void shadeRow(int x, int y, int count, GPixel row[]) = 0;
+
+        /**
+         *  Shade n spans in one call, so that shaders can set up once for all of them rather than once per row.
+         *  By default this is shadeRow() on each.
+         */
+        virtual void shadeSpans(const Span spans[], int n) {
+            for (int i = 0; i < n; i++)
+                shadeRow(spans[i].x, spans[i].y, spans[i].count, spans[i].row);
+        }
+
+        /// Contexts that can't tell say they vary along both axes.
+        virtual int invariance() const { return kVaries; }
+
+        /// The one color every pixel is shaded, if there is one.
+        virtual std::optional<GPixel> constantColor() const { return std::nullopt; }
+    };
+
+    /**
+     *  Return the context for drawing with this shader under ctm, allocated from arena (so it lasts as long as
+     *  the draw does), or nullptr if the shader can't draw under it, e.g. because it can't be inverted.
+     */
+    virtual Context *makeContext(const GMatrix &ctm, GArena &arena) const = 0;
+};
+
+/**
+ *  A shader that keeps its one context in itself: setContext() prepares it for a draw, after which the calls below
+ *  shade that draw. Its makeContext() does just that, so such a shader can only be drawn by one draw at a time.
+ */
+class GSingleContextShader : public GShader {
+public:
+    Context *makeContext(const GMatrix &ctm, GArena &arena) const final;
+
+    bool isThreadSafe() const final { return false; }
+
+    /// The draw calls in GCanvas call this (through makeContext) with the CTM before any calls to shadeRow().
+    virtual bool setContext(const GMatrix &ctm) = 0;
+
+    /// Context::shadeRow() for the draw setContext() prepared for.
     virtual void shadeRow(int x, int y, int count, GPixel row[]) = 0;
+
+    /// Context::shadeSpans(); by default shadeRow() on each.
+    virtual void shadeSpans(const Span spans[], int n) {
+        for (int i = 0; i < n; i++)
+            shadeRow(spans[i].x, spans[i].y, spans[i].count, spans[i].row);
+    }
+
+    /// Valid after setContext(). Shaders that can't tell say they vary along both axes.
+    virtual int invariance() { return kVaries; }
+
+    /// The one color every pixel is shaded, if there is one. Valid after setContext().
+    virtual std::optional<GPixel> constantColor() { return std::nullopt; }
+};
+
+enum class GMipmapMode {
+    kNone,      // always sample the bitmap itself
+    kNearest,   // when drawn smaller, sample the nearest of a pyramid of 2x2 box filtered halvings
+};
+
+enum class GTextureLayout {
+    kRowMajor,  // sample the bitmap's own rows
+    kTiled,     // sample a copy kept in 8x8 blocks, so that rotated and skewed walks stay within a few cache lines
 };
 
 /**
  *  Return a subclass of GShader that draws the specified bitmap and the local matrix.
  *  Returns null if the subclass can not be created.
+ *
+ *  With GMipmapMode::kNearest the halvings are built the first time the bitmap is drawn shrunk by 2 or
+ *  more (just once, even if several threads draw it so at the same time), and kept with the shader; the
+ *  bitmap's pixels must not change while the shader is in use.
+ *
+ *  With GTextureLayout::kTiled the bitmap is copied into blocks when the shader is created, and each halving
+ *  as it is built; draws that neither rotate nor skew it still read its rows directly.
  */
 std::unique_ptr<GShader> GCreateBitmapShader(const GBitmap &, const GMatrix &localMatrix,
-                                             GTileMode = GTileMode::kClamp);
+                                             GTileMode = GTileMode::kClamp,
+                                             GMipmapMode = GMipmapMode::kNone,
+                                             GTextureLayout = GTextureLayout::kRowMajor);
 
 /**
  *  Return a subclass of GShader that draws the specified gradient of [count] colors between
@@ -12,15 +12,36 @@ public:
 
     bool isOpaque() override;
 
-    bool setContext(const GMatrix &ctm) override;
-
-    void shadeRow(int x, int y, int count, GPixel row[]) override;
+    GShader::Context *makeContext(const GMatrix &ctm, GArena &arena) const override;
 
 private:
+    class Context;
+
     GMatrix unit_mapper;
-    std::optional<GMatrix> inv;
-    std::vector<GColor> my_colors;
     GColor color0, diff_color1, diff_color2;
+    bool opaque;
+};
+
+/*
+ * One draw of a GTriangleGradientShader.
+ */
+class GTriangleGradientShader::Context : public GShader::Context {
+public:
+    Context(const GTriangleGradientShader &shader, const GMatrix &inv);
+
+    void shadeRow(int x, int y, int count, GPixel row[]) override;
+
+    void shadeSpans(const Span spans[], int n) override;
+
+    std::optional<GPixel> constantColor() const override;
+
+private:
+    const GTriangleGradientShader &shader;
+    GMatrix inv;
+
+    // How the color changes from one pixel of a row to the next, in float and, when it fits, in fixed point
+    GColor row_step;
+    int32_t step_a = 0, step_r = 0, step_g = 0, step_b = 0;
 };
 
 inline std::unique_ptr<GShader> GCreateTriangleGradient(const GPoint verts[3], const GColor colors[3]) {
@@ -3,82 +3,356 @@
  */
 
 #include "../include/GBitmapShader.h"
+#include "../../include/GArena.h"
 
-MyShader::MyShader(const GBitmap &device, const GMatrix &localMatrix, GTileMode mode) {
+#include <cmath>
+
+MyShader::MyShader(const GBitmap &device, const GMatrix &localMatrix, GTileMode mode, GMipmapMode mipmapMode,
+                   GTextureLayout layout) {
     localBitmap = device;
     this->localMatrix = localMatrix;
+    tileMode = mode;
+    this->mipmapMode = mipmapMode;
+    textureLayout = layout;
 
-    switch (mode) {
-        case GTileMode::kClamp:
-            tiler = tile_clamp;
+    if (textureLayout == GTextureLayout::kTiled) fBlocks = MakeBlocks(localBitmap);
+}
+
+bool MyShader::isOpaque() {
+    return localBitmap.isOpaque();
+}
+
+namespace {
+    enum {
+        kBlockShift = 3,
+        kBlockSize = 1 << kBlockShift,
+    };
+
+
+    template<GTileMode mode>
+    int tile_index(int v, int n) {
+        if constexpr (mode == GTileMode::kClamp) {
+            return std::max(0, std::min(v, n - 1));
+        } else if constexpr (mode == GTileMode::kRepeat) {
+            v %= n;
+            return v < 0 ? v + n : v;
+        } else {
+            v %= 2 * n;
+            if (v < 0) v += 2 * n;
+            return v < n ? v : 2 * n - 1 - v;
+        }
+    }
+
+    /*
+     * A bitmap coordinate stepped in 16.16 fixed point, handing out its texel tiled into [0, n). Repeat and mirror
+     * keep the accumulator within one period (n texels, or 2n there and back for mirror), so that after the
+     * start, which is reduced once, each step wraps with a compare and an add or subtract; no division.
+     */
+    template<GTileMode mode>
+    struct TileStepper {
+        int32_t value, step, period;
+        int n;
+
+        TileStepper(int32_t start, int32_t step, int n) : value(start), step(step), n(n) {
+            period = (mode == GTileMode::kMirror ? 2 * n : n) << 16;
+
+            if constexpr (mode != GTileMode::kClamp) {
+                this->step %= period;
+                value %= period;
+                if (value < 0) value += period;
+            }
+        }
+
+        int next() {
+            int texel = value >> 16;
+            value += step;
+
+            if constexpr (mode == GTileMode::kClamp) {
+                return std::max(0, std::min(texel, n - 1));
+            } else {
+                if (value >= period) value -= period;
+                else if (value < 0) value += period;
+
+                if constexpr (mode == GTileMode::kMirror) {
+                    if (texel >= n) texel = 2 * n - 1 - texel;
+                }
+                return texel;
+            }
+        }
+    };
+
+    // The rounded average of four premultiplied pixels, two channels at a time in each 32 bit half
+    inline GPixel average4(GPixel p0, GPixel p1, GPixel p2, GPixel p3) {
+        const uint32_t mask = 0x00FF00FF;
+
+        uint32_t rb = (p0 & mask) + (p1 & mask) + (p2 & mask) + (p3 & mask) + 0x00020002;
+        uint32_t ag = ((p0 >> 8) & mask) + ((p1 >> 8) & mask) + ((p2 >> 8) & mask) + ((p3 >> 8) & mask) + 0x00020002;
+
+        return ((rb >> 2) & mask) | (((ag >> 2) & mask) << 8);
+    }
+}
+
+MyShader::Blocks MyShader::MakeBlocks(const GBitmap &bitmap) {
+    const int w = bitmap.width(), h = bitmap.height();
+    const int per_row = (w + kBlockSize - 1) >> kBlockShift, block_rows = (h + kBlockSize - 1) >> kBlockShift;
+    const uint32_t block_pixels = kBlockSize * kBlockSize;
+
+    // Blocks are stored row by row. A texel's offset splits into a part from its column (its block across and its
+    // place in the block's row) and a part from its row, so sampling looks both up and adds them
+    Blocks blocks;
+    blocks.columnOffsets.resize(w);
+    for (int x = 0; x < w; x++)
+        blocks.columnOffsets[x] = (x >> kBlockShift) * block_pixels + (x & (kBlockSize - 1));
+
+    blocks.rowOffsets.resize(h);
+    for (int y = 0; y < h; y++)
+        blocks.rowOffsets[y] = (y >> kBlockShift) * per_row * block_pixels + (y & (kBlockSize - 1)) * kBlockSize;
+
+    // Blocks past the right or bottom edge are padded out, and never read
+    blocks.pixels.reset(new GPixel[(size_t) per_row * block_rows * block_pixels]);
+    for (int y = 0; y < h; y++) {
+        const GPixel *src = bitmap.getAddr(0, y);
+        GPixel *dst = blocks.pixels.get() + blocks.rowOffsets[y];
+
+        for (int x = 0; x < w; x++)
+            dst[blocks.columnOffsets[x]] = src[x];
+    }
+
+    return blocks;
+}
+
+void MyShader::buildMipmaps() const {
+    const GBitmap *prev = &localBitmap;
+
+    while (prev->width() > 1 || prev->height() > 1) {
+        int w = std::max(1, prev->width() / 2), h = std::max(1, prev->height() / 2);
+        std::unique_ptr<GPixel[]> pixels(new GPixel[(size_t) w * h]);
+
+        // A side of 1 has nothing to pair with, so it averages with itself
+        int dx = prev->width() > 1 ? 1 : 0, dy = prev->height() > 1 ? 1 : 0;
+
+        for (int y = 0; y < h; y++) {
+            int y0 = dy ? 2 * y : y;
+            const GPixel *row0 = prev->getAddr(0, y0), *row1 = prev->getAddr(0, y0 + dy);
+
+            GPixel *dst = pixels.get() + (size_t) y * w;
+            for (int x = 0; x < w; x++) {
+                int x0 = dx ? 2 * x : x, x1 = x0 + dx;
+                dst[x] = average4(row0[x0], row0[x1], row1[x0], row1[x1]);
+            }
+        }
+
+        GBitmap bitmap(w, h, w * sizeof(GPixel), pixels.get(), localBitmap.isOpaque());
+        Blocks blocks = textureLayout == GTextureLayout::kTiled ? MakeBlocks(bitmap) : Blocks();
+
+        fLevels.push_back({std::move(pixels), bitmap, std::move(blocks)});
+        prev = &fLevels.back().bitmap;
+    }
+}
+
+GShader::Context *MyShader::makeContext(const GMatrix &ctm, GArena &arena) const {
+    std::optional<GMatrix> inv = (ctm * localMatrix).invert();
+    if (!inv.has_value()) return nullptr;
+
+    const GBitmap *source = &localBitmap;
+    const Blocks *blocks = &fBlocks;
+
+    if (mipmapMode == GMipmapMode::kNearest) {
+        // Bitmap pixels per device pixel, along the bitmap axis that shrinks the most
+        const GMatrix &m = inv.value();
+        float step = std::max(std::sqrt(m[0] * m[0] + m[1] * m[1]), std::sqrt(m[2] * m[2] + m[3] * m[3]));
+
+        if (step >= 2) std::call_once(fLevelsBuilt, [this]() { buildMipmaps(); });
+
+        // A 1x1 bitmap has no halvings, and is sampled itself
+        if (step >= 2 && !fLevels.empty()) {
+            const Level &level = fLevels[std::min((int) fLevels.size(), (int) std::log2(step)) - 1];
+            source = &level.bitmap;
+            blocks = &level.blocks;
+
+            // Map onto the level rather than the bitmap, whose sides may not have halved evenly
+            float sx = (float) source->width() / (float) localBitmap.width();
+            float sy = (float) source->height() / (float) localBitmap.height();
+            inv = GMatrix::Scale(sx, sy) * m;
+        }
+    }
+
+    return arena.make<Context>(inv.value(), *source, textureLayout == GTextureLayout::kTiled ? blocks : nullptr,
+                               tileMode);
+}
+
+MyShader::Context::Context(const GMatrix &inv, const GBitmap &source, const Blocks *sourceBlocks, GTileMode mode)
+        : inv(inv), source(source), sourceBlocks(sourceBlocks), tileMode(mode) {
+    const GMatrix &m = inv;
+
+    Sampling sampling;
+    if (m[1] != 0 || m[2] != 0) sampling = Sampling::kAffine;
+    else if (m[0] == 1 && m[3] == 1 && tileMode != GTileMode::kMirror) sampling = Sampling::kTranslate;
+    else sampling = Sampling::kScale;
+
+    switch (sampling) {
+        case Sampling::kTranslate:
+            sampler = &Context::shadeTranslate;
             break;
-        case GTileMode::kRepeat:
-            tiler = tile_repeat;
+        case Sampling::kScale:
+            sampler = &Context::shadeScale;
             break;
-        case GTileMode::kMirror:
-            tiler = tile_mirror;
+        case Sampling::kAffine:
+            sampler = affineSampler();
             break;
     }
 }
 
-bool MyShader::isOpaque() {
-    return localBitmap.isOpaque();
+std::optional<GPixel> MyShader::Context::constantColor() const {
+    // Every tile mode samples the only pixel there is
+    if (source.width() == 1 && source.height() == 1) return *source.getAddr(0, 0);
+
+    return std::nullopt;
 }
 
-bool MyShader::setContext(const GMatrix &ctm) {
-    inv = (ctm * localMatrix).invert();
-    if (!inv.has_value()) return false;
+void MyShader::Context::shadeRow(int x, int y, int count, GPixel row[]) {
+    (this->*sampler)(x, y, count, row);
+}
 
-    inv = inv.value();
-    return true;
+void MyShader::Context::shadeSpans(const Span spans[], int n) {
+    for (int i = 0; i < n; i++)
+        (this->*sampler)(spans[i].x, spans[i].y, spans[i].count, spans[i].row);
 }
 
-void MyShader::shadeRow(int x, int y, int count, GPixel row[]) {
-    auto [inv_x, inv_y] = inv.value() * GPoint{(float) x + 0.5f, (float) y + 0.5f};
+void MyShader::Context::shadeTranslate(int x, int y, int count, GPixel row[]) {
+    const int width = source.width();
+    const GMatrix &m = inv;
 
-    for (int i = 0; i < count; ++i) {
-        auto [clamped_x, clamped_y] = tiler(GFloorToInt(inv_x), GFloorToInt(inv_y), localBitmap.width(),
-                                            localBitmap.height());
+    // floor(x + 0.5 + e) is x + floor(0.5 + e) for whole x, so the row is one run of the bitmap, tiled
+    int src_y = tile(GFloorToInt((float) y + 0.5f + m[5]), source.height());
+    int src_x = x + GFloorToInt(0.5f + m[4]);
+    const GPixel *src = source.getAddr(0, src_y);
+
+    if (tileMode == GTileMode::kClamp) {
+        int before = std::min(count, std::max(0, -src_x));
+        std::fill_n(row, before, src[0]);
 
-        row[i] = *localBitmap.getAddr(clamped_x, clamped_y);
+        int inside = std::max(0, std::min(count - before, width - (src_x + before)));
+        std::copy_n(src + src_x + before, inside, row + before);
 
-        ++x;
-        inv_x += inv.value()[0];
-        inv_y += inv.value()[1];
+        std::fill_n(row + before + inside, count - before - inside, src[width - 1]);
+        return;
+    }
+
+    // Repeat: copy up to the right side of the bitmap, then carry on from its left side
+    src_x = tile(src_x, width);
+    for (int done = 0; done < count;) {
+        int n = std::min(count - done, width - src_x);
+        std::copy_n(src + src_x, n, row + done);
+
+        done += n;
+        src_x = 0;
     }
 }
 
-std::pair<int, int> MyShader::tile_clamp(int x, int y, int width, int height) {
-    return std::make_pair(std::max(0, std::min(x, width - 1)),
-                          std::max(0, std::min(y, height - 1)));
+const int *MyShader::Context::columns(int x, int count) {
+    int cached_right = fColumnsLeft + (int) fColumns.size();
+    if (!fColumns.empty() && x >= fColumnsLeft && x + count <= cached_right) return fColumns.data() + x - fColumnsLeft;
+
+    // Grow the cache to cover the request too; rows of one draw mostly overlap, so this settles quickly
+    int left = fColumns.empty() ? x : std::min(x, fColumnsLeft);
+    int right = fColumns.empty() ? x + count : std::max(x + count, cached_right);
+
+    const GMatrix &m = inv;
+    fColumns.resize(right - left);
+    for (int i = 0; i < right - left; i++) {
+        int src_x = GFloorToInt(m[0] * ((float) (left + i) + 0.5f) + m[4]);
+        fColumns[i] = tile(src_x, source.width());
+    }
+
+    fColumnsLeft = left;
+    return fColumns.data() + x - fColumnsLeft;
 }
 
-std::pair<int, int> MyShader::tile_repeat(int x, int y, int width, int height) {
-    x %= width;
-    y %= height;
+void MyShader::Context::shadeScale(int x, int y, int count, GPixel row[]) {
+    const GMatrix &m = inv;
+
+    int src_y = tile(GFloorToInt(m[3] * ((float) y + 0.5f) + m[5]), source.height());
+    const GPixel *src = source.getAddr(0, src_y);
+    const int *cols = columns(x, count);
 
-    x += width;
-    y += height;
+    for (int i = 0; i < count; ++i)
+        row[i] = src[cols[i]];
+}
 
-    if (x >= width) x -= width;
-    if (y >= height) y -= height;
+MyShader::Context::Sampler MyShader::Context::affineSampler() const {
+    const bool blocks = sourceBlocks != nullptr;
 
-    return std::make_pair(x, y);
+    switch (tileMode) {
+        case GTileMode::kClamp:
+            return blocks ? &Context::sampleAffine<GTileMode::kClamp, true>
+                          : &Context::sampleAffine<GTileMode::kClamp, false>;
+        case GTileMode::kRepeat:
+            return blocks ? &Context::sampleAffine<GTileMode::kRepeat, true>
+                          : &Context::sampleAffine<GTileMode::kRepeat, false>;
+        case GTileMode::kMirror:
+            return blocks ? &Context::sampleAffine<GTileMode::kMirror, true>
+                          : &Context::sampleAffine<GTileMode::kMirror, false>;
+    }
+    return nullptr;
 }
 
-std::pair<int, int> MyShader::tile_mirror(int x, int y, int width, int height) {
-    x %= 2 * width;
-    y %= 2 * height;
+template<GTileMode mode, bool blocks>
+void MyShader::Context::sampleAffine(int x, int y, int count, GPixel row[]) {
+    const GMatrix &m = inv;
+    auto [inv_x, inv_y] = m * GPoint{(float) x + 0.5f, (float) y + 0.5f};
+
+    const int width = source.width(), height = source.height();
 
-    if (x < 0) x += 2 * width;
-    if (y < 0) y += 2 * height;
+    // Step in 16.16 fixed point, as long as the whole span and a period of the bitmap stay within its range
+    const float limit = 16000.0f, end_x = inv_x + m[0] * (float) count, end_y = inv_y + m[1] * (float) count;
+    if (std::max({std::abs(inv_x), std::abs(inv_y), std::abs(end_x), std::abs(end_y)}) < limit &&
+        std::max(width, height) < 4096) {
+        TileStepper<mode> sx(GRoundToInt(inv_x * 65536.0f), GRoundToInt(m[0] * 65536.0f), width);
+        TileStepper<mode> sy(GRoundToInt(inv_y * 65536.0f), GRoundToInt(m[1] * 65536.0f), height);
 
-    if (x >= width) x = 2 * width - x - 1;
-    if (y >= height) y = 2 * height - y - 1;
+        if constexpr (blocks) {
+            const GPixel *pixels = sourceBlocks->pixels.get();
+            const uint32_t *columns = sourceBlocks->columnOffsets.data(), *rows = sourceBlocks->rowOffsets.data();
 
-    return std::make_pair(x, y);
+            for (int i = 0; i < count; ++i) {
+                int src_x = sx.next();
+                row[i] = pixels[columns[src_x] + rows[sy.next()]];
+            }
+        } else {
+            const GPixel *pixels = source.pixels();
+            const size_t stride = source.rowBytes() >> 2;
+
+            for (int i = 0; i < count; ++i) {
+                int src_x = sx.next();
+                row[i] = pixels[(size_t) sy.next() * stride + src_x];
+            }
+        }
+        return;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        row[i] = *source.getAddr(tile_index<mode>(GFloorToInt(inv_x), width),
+                                 tile_index<mode>(GFloorToInt(inv_y), height));
+
+        inv_x += m[0];
+        inv_y += m[1];
+    }
+}
+
+int MyShader::Context::tile(int v, int n) const {
+    switch (tileMode) {
+        case GTileMode::kClamp:
+            return tile_index<GTileMode::kClamp>(v, n);
+        case GTileMode::kRepeat:
+            return tile_index<GTileMode::kRepeat>(v, n);
+        case GTileMode::kMirror:
+            return tile_index<GTileMode::kMirror>(v, n);
+    }
+    return 0;
 }
 
-std::unique_ptr<GShader> GCreateBitmapShader(const GBitmap &device, const GMatrix &localMatrix, GTileMode mode) {
-    return std::unique_ptr<GShader>(new MyShader(device, localMatrix, mode));
+std::unique_ptr<GShader> GCreateBitmapShader(const GBitmap &device, const GMatrix &localMatrix, GTileMode mode,
+                                             GMipmapMode mipmapMode, GTextureLayout layout) {
+    return std::unique_ptr<GShader>(new MyShader(device, localMatrix, mode, mipmapMode, layout));
 }
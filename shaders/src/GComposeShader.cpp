@@ -1,4 +1,40 @@
 #include "../include/GComposeShader.h"
+#include "../../include/GArena.h"
+
+#include <utility>
+
+namespace {
+    // Pixels shaded per pass, so both children's output stays in L1 between shading and modulating
+    constexpr int kChunk = 64;
+
+    /*
+     * row[i] = row[i] * other[i], channel by channel. When one side is known to be opaque the product's alpha is
+     * just the other side's, so keep_alpha skips that multiply.
+     */
+    template<bool keep_alpha>
+    void modulate(GPixel row[], const GPixel other[], int count) {
+        for (int i = 0; i < count; ++i) {
+            GPixel a = row[i], b = other[i];
+
+            unsigned alpha = keep_alpha ? GPixel_GetA(a) : gutils::divBy255(GPixel_GetA(a) * GPixel_GetA(b));
+            row[i] = GPixel_PackARGB(alpha,
+                                     gutils::divBy255(GPixel_GetR(a) * GPixel_GetR(b)),
+                                     gutils::divBy255(GPixel_GetG(a) * GPixel_GetG(b)),
+                                     gutils::divBy255(GPixel_GetB(a) * GPixel_GetB(b)));
+        }
+    }
+
+    // row[i] = row[i] * color, channel by channel
+    void modulate(GPixel row[], GPixel color, int count) {
+        const unsigned a = GPixel_GetA(color), r = GPixel_GetR(color), g = GPixel_GetG(color), b = GPixel_GetB(color);
+
+        for (int i = 0; i < count; ++i) {
+            GPixel p = row[i];
+            row[i] = GPixel_PackARGB(gutils::divBy255(GPixel_GetA(p) * a), gutils::divBy255(GPixel_GetR(p) * r),
+                                     gutils::divBy255(GPixel_GetG(p) * g), gutils::divBy255(GPixel_GetB(p) * b));
+        }
+    }
+}
 
 GComposeShader::GComposeShader(GShader &gradient, GShader &proxy) : gradient_shader(&gradient), proxy_shader(&proxy) {}
 
@@ -6,20 +42,82 @@ bool GComposeShader::isOpaque() {
     return gradient_shader->isOpaque() && proxy_shader->isOpaque();
 }
 
-bool GComposeShader::setContext(const GMatrix &ctm) {
-    return gradient_shader->setContext(ctm) && proxy_shader->setContext(ctm);
+bool GComposeShader::isThreadSafe() const {
+    return gradient_shader->isThreadSafe() && proxy_shader->isThreadSafe();
+}
+
+GShader::Context *GComposeShader::makeContext(const GMatrix &ctm, GArena &arena) const {
+    GShader::Context *gradient = gradient_shader->makeContext(ctm, arena);
+    GShader::Context *proxy = gradient != nullptr ? proxy_shader->makeContext(ctm, arena) : nullptr;
+    if (proxy == nullptr) return nullptr;
+
+    return arena.make<Context>(gradient, gradient_shader->isOpaque(), proxy, proxy_shader->isOpaque());
 }
 
-void GComposeShader::shadeRow(int x, int y, int count, GPixel *row) {
-    GPixel gradient_row[count], proxy_row[count];
+GComposeShader::Context::Context(GShader::Context *gradient, bool gradient_opaque, GShader::Context *proxy,
+                                 bool proxy_opaque) {
+    // Shade whichever child is opaque second, so the result keeps the first one's alpha
+    first = gradient, second = proxy;
+    keep_alpha = proxy_opaque;
+    if (!keep_alpha && gradient_opaque) {
+        std::swap(first, second);
+        keep_alpha = true;
+    }
+
+    child_color = gradient->constantColor();
+    varying_child = proxy;
+    if (!child_color.has_value()) {
+        child_color = proxy->constantColor();
+        varying_child = gradient;
+    }
+}
+
+void GComposeShader::Context::shadeSpans(const Span spans[], int n) {
+    if (!child_color.has_value()) {
+        for (int i = 0; i < n; i++)
+            Context::shadeRow(spans[i].x, spans[i].y, spans[i].count, spans[i].row);
+        return;
+    }
+
+    // Only one child varies, so it can shade the whole batch itself
+    varying_child->shadeSpans(spans, n);
+
+    if (*child_color != GPixel_PackARGB(255, 255, 255, 255))
+        for (int i = 0; i < n; i++)
+            modulate(spans[i].row, *child_color, spans[i].count);
+}
+
+int GComposeShader::Context::invariance() const {
+    return first->invariance() & second->invariance();
+}
+
+std::optional<GPixel> GComposeShader::Context::constantColor() const {
+    std::optional<GPixel> other = varying_child->constantColor();
+    if (!child_color.has_value() || !other.has_value()) return std::nullopt;
+
+    GPixel color = *other;
+    modulate(&color, *child_color, 1);
+    return color;
+}
+
+void GComposeShader::Context::shadeRow(int x, int y, int count, GPixel *row) {
+    if (child_color.has_value()) {
+        varying_child->shadeRow(x, y, count, row);
+
+        // Opaque white leaves the other child as it is
+        if (*child_color != GPixel_PackARGB(255, 255, 255, 255)) modulate(row, *child_color, count);
+        return;
+    }
+
+    GPixel scratch[kChunk];
+
+    for (int done = 0; done < count; done += kChunk) {
+        int n = std::min(kChunk, count - done);
 
-    gradient_shader->shadeRow(x, y, count, gradient_row);
-    proxy_shader->shadeRow(x, y, count, proxy_row);
+        first->shadeRow(x + done, y, n, row + done);
+        second->shadeRow(x + done, y, n, scratch);
 
-    for (int i = 0; i < count; ++i) {
-        row[i] = GPixel_PackARGB(gutils::divBy255(GPixel_GetA(gradient_row[i]) * GPixel_GetA(proxy_row[i])),
-                                 gutils::divBy255(GPixel_GetR(gradient_row[i]) * GPixel_GetR(proxy_row[i])),
-                                 gutils::divBy255(GPixel_GetG(gradient_row[i]) * GPixel_GetG(proxy_row[i])),
-                                 gutils::divBy255(GPixel_GetB(gradient_row[i]) * GPixel_GetB(proxy_row[i])));
+        if (keep_alpha) modulate<true>(row + done, scratch, n);
+        else modulate<false>(row + done, scratch, n);
     }
 }
@@ -3,136 +3,171 @@
  */
 
 #include "../include/GLinearGradientShader.h"
+#include "../../include/GArena.h"
 
-GLinearGradientShader::GLinearGradientShader(GPoint p0, GPoint p1, const GColor _colors[], int count, GTileMode mode) {
+#include <cmath>
+
+namespace {
+    // t in table entries scaled by 16.16, so that the entry for a pixel is u >> 16. Spans far off either end, or
+    // steps too large to matter, are limited first; the pixels they reach are all ends, which such limits keep
+    inline int64_t clamp_fixed(float t, int entries) {
+        double limited = std::max(-(double) (1 << 24), std::min((double) (1 << 24), (double) t));
+        return (int64_t) std::llround(limited * entries * 65536.0);
+    }
+
+    // t reduced to one period (of period_t, with period table entries in 16.16), and then scaled likewise
+    inline int32_t tiled_fixed(float t, float period_t, int32_t period, int entries) {
+        t -= period_t * std::floor(t / period_t);
+        return std::min(period - 1, std::max(0, (int32_t) std::lround((double) t * entries * 65536.0)));
+    }
+}
+
+GLinearGradientShader::GLinearGradientShader(GPoint p0, GPoint p1, const GColor colors[], int count, GTileMode mode) {
     float dx = p1.x - p0.x;
     float dy = p1.y - p0.y;
 
     tile_mode = mode;
 
-    switch (mode) {
-        case GTileMode::kClamp:
-            break;
-        case GTileMode::kRepeat:
-            tiler = tile_repeat;
-            break;
-        case GTileMode::kMirror:
-            tiler = tile_mirror;
-            break;
-    }
-
     line_mapper = {dx, -dy, p0.x,
                    dy, dx, p0.y};
 
     num_colors = count;
 
-    premul_ends.first = gutils::premul_255(_colors[0]);
-    premul_ends.second = gutils::premul_255(_colors[count - 1]);
+    premul_ends.first = gutils::premul_255(colors[0]);
+    premul_ends.second = gutils::premul_255(colors[count - 1]);
+
+    opaque = std::all_of(colors, colors + count, [](const GColor &c) { return c.a >= 1; });
 
-    if (num_colors == 1) return;
+    auto same = [&](const GColor &c) {
+        return c.r == colors[0].r && c.g == colors[0].g && c.b == colors[0].b && c.a == colors[0].a;
+    };
+    if (std::all_of(colors, colors + count, same)) {
+        constant = premul_ends.first;
+        num_colors = 1;
+        return;
+    }
 
-    colors.resize(count);
-    for (int i = 0; i < count; i++)
-        colors[i] = _colors[i];
+    // Interpolate unpremultiplied, then premultiply, once per entry rather than once per pixel
+    lut.resize(mode == GTileMode::kMirror ? 2 * kLutSize : kLutSize);
+    for (int i = 0; i < kLutSize; i++) {
+        float scaled = ((float) i + 0.5f) / (float) kLutSize * (float) (count - 1);
+        int k = std::min(GFloorToInt(scaled), count - 2);
+        float dist = scaled - (float) k;
 
-    colors_diff.resize(count);
-    for (int i = 0; i < count - 1; i++) {
-        colors_diff[i].r = _colors[i + 1].r - _colors[i].r;
-        colors_diff[i].g = _colors[i + 1].g - _colors[i].g;
-        colors_diff[i].b = _colors[i + 1].b - _colors[i].b;
-        colors_diff[i].a = _colors[i + 1].a - _colors[i].a;
+        const GColor &c0 = colors[k], &c1 = colors[k + 1];
+        lut[i] = gutils::premul_255({c0.r + dist * (c1.r - c0.r), c0.g + dist * (c1.g - c0.g),
+                                     c0.b + dist * (c1.b - c0.b), c0.a + dist * (c1.a - c0.a)});
     }
+
+    if (mode == GTileMode::kMirror)
+        std::reverse_copy(lut.begin(), lut.begin() + kLutSize, lut.begin() + kLutSize);
 }
 
 bool GLinearGradientShader::isOpaque() {
-    return false;
+    return opaque;
 }
 
-bool GLinearGradientShader::setContext(const GMatrix &ctm) {
-    inv = (ctm * line_mapper).invert();
-    return inv.has_value();
+GShader::Context *GLinearGradientShader::makeContext(const GMatrix &ctm, GArena &arena) const {
+    std::optional<GMatrix> inv = (ctm * line_mapper).invert();
+    if (!inv.has_value()) return nullptr;
+
+    return arena.make<Context>(*this, inv.value());
 }
 
-void GLinearGradientShader::shadeRow(int x, int y, int count, GPixel row[]) {
-    switch (num_colors) {
-        case 1:
-            std::fill(row, row + count, premul_ends.first);
-            break;
-        case 2:
-            shadeRow<true>(x, y, count, row);
-            break;
-        default:
-            shadeRow<false>(x, y, count, row);
+GLinearGradientShader::Context::Context(const GLinearGradientShader &shader, const GMatrix &inv)
+        : shader(shader), inv(inv) {
+    if (shader.num_colors == 1) return;
+
+    const float dt = inv[0];
+    if (shader.tile_mode == GTileMode::kClamp) {
+        u_step = clamp_fixed(dt, kLutSize);
+    } else {
+        const int32_t period = (int32_t) shader.lut.size() << 16;
+        u_step = tiled_fixed(dt, shader.tile_mode == GTileMode::kMirror ? 2.0f : 1.0f, period, kLutSize);
+
+        // A step just short of a whole period is really a small step back, which keeps the wrap to one compare
+        if (u_step > period / 2) u_step -= period;
     }
 }
 
-std::pair<int, float> GLinearGradientShader::tile_repeat(float x, int num_colors) {
-    x = x - floor(x); // Now x is in between [0, 1] and we are ready to scale.
+std::optional<GPixel> GLinearGradientShader::Context::constantColor() const {
+    return shader.constant;
+}
 
-    float scaled_x = x * (float) (num_colors - 1);
-    int floored_x = GFloorToInt(scaled_x);
-    float dist = (scaled_x - (float) floored_x);
+int GLinearGradientShader::Context::invariance() const {
+    if (shader.num_colors == 1) return kXInvariant | kYInvariant;
 
-    return std::make_pair(abs(floored_x), dist);
+    // t only depends on the device axes the inverse mixes into it
+    const GMatrix &m = inv;
+    return (m[0] == 0 ? kXInvariant : kVaries) | (m[2] == 0 ? kYInvariant : kVaries);
 }
 
-std::pair<int, float> GLinearGradientShader::tile_mirror(float x, int num_colors) {
-    x *= 0.5f;
-    x = x - floor(x);
-    if (x > 0.5f)
-        x = 1 - x;
+void GLinearGradientShader::Context::shadeRow(int x, int y, int count, GPixel row[]) {
+    if (shader.num_colors == 1) {
+        std::fill(row, row + count, shader.premul_ends.first);
+        return;
+    }
 
-    x *= 2;
+    // Map param x onto the x-axis to make computation easier. We do matrix multiplication but on a "single cell" matrix
+    const GMatrix &m = inv;
+    float t = m[0] * ((float) x + 0.5f) + m[2] * ((float) y + 0.5f) + m[4];
 
-    float scaled_x = x * (float) (num_colors - 1);
-    int floored_x = GFloorToInt(scaled_x);
-    float dist = (scaled_x - (float) floored_x);
+    if (shader.tile_mode == GTileMode::kClamp) shadeClamp(t, count, row);
+    else shadeTiled(t, count, row);
+}
 
-    return std::make_pair(abs(floored_x), dist);
+void GLinearGradientShader::Context::shadeSpans(const Span spans[], int n) {
+    for (int i = 0; i < n; i++)
+        Context::shadeRow(spans[i].x, spans[i].y, spans[i].count, spans[i].row);
 }
 
-template<bool two_colors>
-void GLinearGradientShader::shadeRow(int x, int y, int count, GPixel row[]) {
-    // Map param x onto the x-axis to make computation easier. We do matrix multiplication but on a "single cell" matrix
-    float inv_x = inv.value()[0] * ((float) x + 0.5f) + inv.value()[2] * ((float) y + 0.5f) + inv.value()[4];
-
-    for (int i = 0; i < count; ++i) {
-        bool smaller = inv_x <= 0.0f;
-        bool greater = inv_x >= 1.0f;
-
-        if (smaller && tile_mode == GTileMode::kClamp) {
-            row[i] = premul_ends.first;
-        } else if (greater && tile_mode == GTileMode::kClamp) {
-            row[i] = premul_ends.second;
-        } else {
-            float scaled_x, dist;
-            int floored_x;
-
-            if (smaller || greater) {
-                std::pair<int, float> res = tiler(inv_x, num_colors);
-                floored_x = res.first;
-                dist = res.second;
-            } else {
-                if (two_colors) {
-                    floored_x = 0;
-                    dist = inv_x;
-                } else {
-                    scaled_x = inv_x * (float) (num_colors - 1);
-                    floored_x = GFloorToInt(scaled_x);
-                    dist = (scaled_x - (float) floored_x);
-                }
-            }
-
-            GColor pixel_color{colors[floored_x].r + dist * colors_diff[floored_x].r,
-                               colors[floored_x].g + dist * colors_diff[floored_x].g,
-                               colors[floored_x].b + dist * colors_diff[floored_x].b,
-                               colors[floored_x].a + dist * colors_diff[floored_x].a};
-
-            row[i] = gutils::premul_255(pixel_color);
-        }
-
-        inv_x += inv.value()[0];
-        ++x;
+void GLinearGradientShader::Context::shadeClamp(float t, int count, GPixel row[]) {
+    const int64_t u0 = clamp_fixed(t, kLutSize), du = u_step, end = (int64_t) kLutSize << 16;
+    const GPixel *lut = shader.lut.data();
+
+    // The pixels up to first_in are on the starting end, from first_out on the other; both are where u crosses
+    // into or out of [0, end), which stepping by du reaches after a whole number of pixels
+    auto steps_until = [count](int64_t distance, int64_t step) {
+        return (int) std::min<int64_t>(count, distance <= 0 ? 0 : (distance + step - 1) / step);
+    };
+
+    int first_in, first_out;
+    GPixel before, after;
+    if (du >= 0) {
+        first_in = du == 0 ? (u0 < 0 ? count : 0) : steps_until(-u0, du);
+        first_out = du == 0 ? (u0 < end ? count : 0) : steps_until(end - u0, du);
+        before = shader.premul_ends.first, after = shader.premul_ends.second;
+    } else {
+        first_in = steps_until(u0 - end + 1, -du);
+        first_out = steps_until(u0 + 1, -du);
+        before = shader.premul_ends.second, after = shader.premul_ends.first;
+    }
+    first_out = std::max(first_in, first_out);
+
+    std::fill(row, row + first_in, before);
+
+    int64_t u = u0 + first_in * du;
+    for (int i = first_in; i < first_out; i++) {
+        row[i] = lut[u >> 16];
+        u += du;
+    }
+
+    std::fill(row + first_out, row + count, after);
+}
+
+void GLinearGradientShader::Context::shadeTiled(float t, int count, GPixel row[]) {
+    // The start and step are reduced to one period of t; then each step wraps with a compare and a subtract or add
+    const GPixel *lut = shader.lut.data();
+    const int32_t period = (int32_t) shader.lut.size() << 16;
+    int32_t u = tiled_fixed(t, shader.tile_mode == GTileMode::kMirror ? 2.0f : 1.0f, period, kLutSize);
+    const int32_t du = (int32_t) u_step;
+
+    for (int i = 0; i < count; i++) {
+        row[i] = lut[u >> 16];
+
+        u += du;
+        if (u >= period) u -= period;
+        else if (u < 0) u += period;
     }
 }
 
@@ -4,8 +4,6 @@
 
 #include "../include/GProxyShader.h"
 
-#include <utility>
-
 GProxyShader::GProxyShader(GShader &shader, const GMatrix &transformer) : real_shader(&shader),
                                                                            extra_transformer(transformer) {}
 
@@ -13,10 +11,10 @@ bool GProxyShader::isOpaque() {
     return real_shader->isOpaque();
 }
 
-bool GProxyShader::setContext(const GMatrix &ctm) {
-    return real_shader->setContext(ctm * extra_transformer);
+bool GProxyShader::isThreadSafe() const {
+    return real_shader->isThreadSafe();
 }
 
-void GProxyShader::shadeRow(int x, int y, int count, GPixel *row) {
-    real_shader->shadeRow(x, y, count, row);
+GShader::Context *GProxyShader::makeContext(const GMatrix &ctm, GArena &arena) const {
+    return real_shader->makeContext(ctm * extra_transformer, arena);
 }
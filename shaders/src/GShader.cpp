@@ -0,0 +1,43 @@
+/*
+ *  Copyright 2024 Aruj Bansal
+ */
+
+#include "../include/GShader.h"
+#include "../../include/GArena.h"
+
+namespace {
+    /*
+     * The context of a GSingleContextShader, which is kept in the shader, so this just shades through it.
+     */
+    class SingleContext : public GShader::Context {
+    public:
+        explicit SingleContext(GSingleContextShader *shader) : fShader(shader) {}
+
+        void shadeRow(int x, int y, int count, GPixel row[]) override {
+            fShader->shadeRow(x, y, count, row);
+        }
+
+        void shadeSpans(const GShader::Span spans[], int n) override {
+            fShader->shadeSpans(spans, n);
+        }
+
+        int invariance() const override {
+            return fShader->invariance();
+        }
+
+        std::optional<GPixel> constantColor() const override {
+            return fShader->constantColor();
+        }
+
+    private:
+        GSingleContextShader *fShader;
+    };
+}
+
+GShader::Context *GSingleContextShader::makeContext(const GMatrix &ctm, GArena &arena) const {
+    // Drawing such a shader sets its context, so it was never really const
+    auto *shader = const_cast<GSingleContextShader *>(this);
+    if (!shader->setContext(ctm)) return nullptr;
+
+    return arena.make<SingleContext>(shader);
+}
@@ -3,6 +3,35 @@
  */
 
 #include "../include/GTriangleGradientShader.h"
+#include "../../include/GArena.h"
+
+namespace {
+    // Channels are stepped in fixed point with 24 fractional bits, then narrowed to 15 bits to premultiply
+    constexpr int kFracBits = 24;
+    constexpr int kNarrowShift = kFracBits - 15;
+    constexpr int32_t kOne = 1 << kFracBits;
+
+    // Colors further out than this could overflow the fixed point steps, so they are shaded in float
+    constexpr float kMaxFixed = 4.0f;
+
+    inline int32_t to_fixed(float x) {
+        return (int32_t) GRoundToInt(x * (float) kOne);
+    }
+
+    // Unit value (1.0 is 1 << 15) of a channel, clamped to [0, 1]
+    inline int32_t narrow(int32_t x) {
+        return std::max(0, std::min(kOne, x)) >> kNarrowShift;
+    }
+
+    // Round a unit value to [0, 255]
+    inline unsigned to_255(int32_t unit) {
+        return (unsigned) ((unit * 255 + (1 << 14)) >> 15);
+    }
+
+    inline bool fits_fixed(const GColor &c) {
+        return std::max({std::abs(c.r), std::abs(c.g), std::abs(c.b), std::abs(c.a)}) < kMaxFixed;
+    }
+}
 
 GTriangleGradientShader::GTriangleGradientShader(const GPoint verts[3], const GColor colors[3]) {
     GPoint vec_u = verts[1] - verts[0];
@@ -14,31 +43,81 @@ GTriangleGradientShader::GTriangleGradientShader(const GPoint verts[3], const GC
     color0 = colors[0];
     diff_color1 = colors[1] - colors[0];
     diff_color2 = colors[2] - colors[0];
-    my_colors = {colors[0], colors[1], colors[2]};
+
+    // Alpha is interpolated between the corners, so it is 1 everywhere when it is 1 at each of them
+    opaque = colors[0].a >= 1 && colors[1].a >= 1 && colors[2].a >= 1;
 }
 
 bool GTriangleGradientShader::isOpaque() {
-    return false;
+    return opaque;
 }
 
-bool GTriangleGradientShader::setContext(const GMatrix &ctm) {
-    inv = (ctm * unit_mapper).invert();
-    return inv.has_value();
+GShader::Context *GTriangleGradientShader::makeContext(const GMatrix &ctm, GArena &arena) const {
+    std::optional<GMatrix> inv = (ctm * unit_mapper).invert();
+    if (!inv.has_value()) return nullptr;
+
+    return arena.make<Context>(*this, inv.value());
 }
 
-void GTriangleGradientShader::shadeRow(int x, int y, int count, GPixel *row) {
-    GPoint p = inv.value() * GPoint{(float) x + 0.5f, (float) y + 0.5f};
+GTriangleGradientShader::Context::Context(const GTriangleGradientShader &shader, const GMatrix &inv)
+        : shader(shader), inv(inv) {
+    row_step = inv[0] * shader.diff_color1 + inv[1] * shader.diff_color2;
+    if (fits_fixed(row_step)) {
+        step_a = to_fixed(row_step.a), step_r = to_fixed(row_step.r);
+        step_g = to_fixed(row_step.g), step_b = to_fixed(row_step.b);
+    }
+}
 
-    GColor diff_color = inv.value()[0] * diff_color1 + inv.value()[1] * diff_color2;
-    GColor cur_color = p.x * diff_color1 + p.y * diff_color2 + color0;
+std::optional<GPixel> GTriangleGradientShader::Context::constantColor() const {
+    auto zero = [](const GColor &c) { return c.r == 0 && c.g == 0 && c.b == 0 && c.a == 0; };
+    if (zero(shader.diff_color1) && zero(shader.diff_color2)) return gutils::premul_255_clamp(shader.color0);
 
+    return std::nullopt;
+}
+
+void GTriangleGradientShader::Context::shadeSpans(const Span spans[], int n) {
+    for (int i = 0; i < n; i++)
+        Context::shadeRow(spans[i].x, spans[i].y, spans[i].count, spans[i].row);
+}
+
+void GTriangleGradientShader::Context::shadeRow(int x, int y, int count, GPixel *row) {
+    GPoint p = inv * GPoint{(float) x + 0.5f, (float) y + 0.5f};
+
+    const GColor &diff_color = row_step;
+    GColor cur_color = p.x * shader.diff_color1 + p.y * shader.diff_color2 + shader.color0;
+
+    // The ends of a span can land just outside the triangle, so only they need clamping
     row[0] = gutils::premul_255_clamp(cur_color);
+    if (count == 1) return;
+
+    row[count - 1] = gutils::premul_255_clamp(cur_color + diff_color * (float) (count - 1));
+    if (count == 2) return;
+
     cur_color += diff_color;
 
-    for (int i = 1; i < count - 1; ++i) {
-        row[i] = gutils::premul_255(cur_color);
-        cur_color += diff_color;
+    if (!fits_fixed(cur_color) || !fits_fixed(diff_color * (float) count)) {
+        for (int i = 1; i < count - 1; ++i) {
+            row[i] = gutils::premul_255(cur_color);
+            cur_color += diff_color;
+        }
+        return;
     }
 
-    row[count - 1] = gutils::premul_255_clamp(cur_color);
+    // Unpremultiplied channels are linear along the row, so step them; premultiplying is then integer math
+    int32_t a = to_fixed(cur_color.a), r = to_fixed(cur_color.r), g = to_fixed(cur_color.g), b = to_fixed(cur_color.b);
+    const int32_t da = step_a, dr = step_r, dg = step_g, db = step_b;
+
+    for (int i = 1; i < count - 1; ++i) {
+        int32_t unit_a = narrow(a);
+
+        row[i] = GPixel_PackARGB(to_255(unit_a),
+                                 to_255((unit_a * narrow(r) + (1 << 14)) >> 15),
+                                 to_255((unit_a * narrow(g) + (1 << 14)) >> 15),
+                                 to_255((unit_a * narrow(b) + (1 << 14)) >> 15));
+
+        a += da;
+        r += dr;
+        g += dg;
+        b += db;
+    }
 }
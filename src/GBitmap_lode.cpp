@@ -48,43 +48,67 @@ bool GBitmap::writeToFile(const char path[]) const {
 
 ///////////////////////////////////////////////////////////////////////////////
 
-static int alpha_mul(unsigned a, unsigned c) {
-    return (a * c + 127) / 255;
+// (x + 1 + (x >> 8)) >> 8 is x / 255 for every x up to 255 * 255 + 127, in each 16 bit half at once
+static inline uint32_t div255_pairs(uint32_t x) {
+    return ((x + 0x00010001 + ((x >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
 }
 
-static void swizzle_rgba_row(GPixel dst[], const uint8_t src[], int count) {
-    for (int i = 0; i < count; ++i) {
-        unsigned a = src[3];
-        dst[i] = GPixel_PackARGB(a,
-                                 alpha_mul(a, src[0]),
-                                 alpha_mul(a, src[1]),
-                                 alpha_mul(a, src[2]));
-        src += 4;
+/*
+ *  Premultiply count RGBA pixels, rounding c * a / 255 to nearest, and swizzle them into GPixels. Red and blue
+ *  are multiplied together, one in each half of a 32 bit word, so no channel needs a divide. src and dst may be
+ *  the same memory, as each pixel is read before it is written.
+ *
+ *  Returns true if every pixel is opaque.
+ */
+static bool swizzle_rgba_row(GPixel dst[], const uint8_t src[], int count) {
+    unsigned all_a = 0xFF;
+
+    for (int i = 0; i < count; ++i, src += 4) {
+        const unsigned r = src[0], g = src[1], b = src[2], a = src[3];
+        all_a &= a;
+
+        if (a == 0xFF) {
+            dst[i] = GPixel_PackARGB(a, r, g, b);
+        } else {
+            uint32_t rb = div255_pairs((r | b << 16) * a + 0x007F007F);
+            uint32_t g_premul = div255_pairs(g * a + 0x7F);
+            dst[i] = GPixel_PackARGB(a, rb & 0xFF, g_premul, rb >> 16);
+        }
     }
+    return all_a == 0xFF;
 }
 
-bool GBitmap::readFromFile(const char path[]) {
+bool GBitmap::readFromMemory(const void* data, size_t size) {
     unsigned w, h;
     unsigned char* pix = nullptr;
-    if (lodepng_decode32_file(&pix, &w, &h, path)) {
+    if (lodepng_decode32(&pix, &w, &h, static_cast<const unsigned char*>(data), size)) {
         free(pix);
+        this->reset();
         return false;
     }
 
-    this->alloc(w, h);
-
-    GPixel* dst = this->pixels();
-    const uint8_t* src = pix;
-    size_t rb = w * 4;
+    // The decoded rows are packed RGBA, 4 bytes a pixel like GPixel, so they are swizzled in place and the
+    // bitmap takes over lodepng's (malloc'd) buffer rather than copying it into one of its own
+    GPixel* pixels = (GPixel*)pix;
+    bool opaque = true;
     for (unsigned y = 0; y < h; ++y) {
-        swizzle_rgba_row(dst, src, w);
-        src += rb;
-        dst += this->rowBytes() / 4;
+        opaque &= swizzle_rgba_row(pixels + (size_t)y * w, pix + (size_t)y * w * 4, w);
     }
-    free(pix);
 
-    this->setIsOpaque(kCompute_IsOpaque);
+    this->reset(w, h, w * sizeof(GPixel), pixels, opaque ? kYes_IsOpaque : kNo_IsOpaque);
     return true;
 }
 
+bool GBitmap::readFromFile(const char path[]) {
+    unsigned char* data = nullptr;
+    size_t size = 0;
+    if (lodepng_load_file(&data, &size, path)) {
+        free(data);
+        this->reset();
+        return false;
+    }
 
+    bool ok = this->readFromMemory(data, size);
+    free(data);
+    return ok;
+}
@@ -0,0 +1,359 @@
+/*
+ *  Copyright 2024 Aruj Bansal
+ */
+
+#include "../include/GBlitter.h"
+#include "../include/GBlender.h"
+#include "../include/GUtils.h"
+#include "../shaders/include/GShader.h"
+
+using BlendProc = GPixel (*)(GPixel, GPixel);
+using BlitzProc = void (*)(int, int, int, const GBitmap &, const GPixel *);
+
+enum {
+    // The most spans, and pixels, a shader blitter hands its shader at once
+    kMaxBatchSpans = 16,
+    kMaxBatchPixels = 512,
+};
+
+template<bool has_shader>
+struct BlitRow {
+    template<BlendProc blend_function>
+    static void blit_row(int x1, int x2, int y, const GBitmap &device, const GPixel row[]) {
+        for (int x = x1; x < x2; x++) {
+            GPixel *dst = device.getAddr(x, y);
+
+            if (has_shader) *dst = blend_function(row[x - x1], *dst);
+            else *dst = blend_function(row[0], *dst);
+        }
+    }
+
+    constexpr static const BlitzProc normal_blend[12] = {blit_row<GBlender::kClear>,
+                                                         blit_row<GBlender::kSrc>,
+                                                         blit_row<GBlender::kDst>,
+                                                         blit_row<GBlender::kSrcOver>,
+                                                         blit_row<GBlender::kDstOver>,
+                                                         blit_row<GBlender::kSrcIn>,
+                                                         blit_row<GBlender::kDstIn>,
+                                                         blit_row<GBlender::kSrcOut>,
+                                                         blit_row<GBlender::kDstOut>,
+                                                         blit_row<GBlender::kSrcATop>,
+                                                         blit_row<GBlender::kDstATop>,
+                                                         blit_row<GBlender::kXor>};
+
+    constexpr static const BlitzProc blend255[12] = {blit_row<GBlender::kClear>,
+                                                     blit_row<GBlender::kSrc>,
+                                                     blit_row<GBlender::kDst>,
+                                                     blit_row<GBlender::kSrc>,
+                                                     blit_row<GBlender::kDstOver>,
+                                                     blit_row<GBlender::kSrcIn>,
+                                                     blit_row<GBlender::kDst>,
+                                                     blit_row<GBlender::kSrcOut>,
+                                                     blit_row<GBlender::kClear>,
+                                                     blit_row<GBlender::kSrcIn>,
+                                                     blit_row<GBlender::kDstOver>,
+                                                     blit_row<GBlender::kSrcOut>};
+
+
+    constexpr static const BlitzProc blend0[12] = {blit_row<GBlender::kClear>,
+                                                   blit_row<GBlender::kClear>,
+                                                   blit_row<GBlender::kDst>,
+                                                   blit_row<GBlender::kDst>,
+                                                   blit_row<GBlender::kDst>,
+                                                   blit_row<GBlender::kClear>,
+                                                   blit_row<GBlender::kClear>,
+                                                   blit_row<GBlender::kClear>,
+                                                   blit_row<GBlender::kDst>,
+                                                   blit_row<GBlender::kDst>,
+                                                   blit_row<GBlender::kClear>,
+                                                   blit_row<GBlender::kDst>};
+};
+
+void GBlitter::blitRect(int x, int y, int w, int h) {
+    for (int bottom = y + h; y < bottom; y++)
+        blitH(x, y, w);
+}
+
+void GBlitter::blitSpans(const GSpan spans[], int count) {
+    for (int i = 0; i < count; i++)
+        blitH(spans[i].x, spans[i].y, spans[i].w);
+}
+
+/*
+ * A single color. When it simply replaces the destination the rows are plain fills.
+ */
+class GSolidBlitter : public GBlitter {
+public:
+    GSolidBlitter(const GBitmap &device, GPixel color, BlitzProc proc, bool fills)
+            : fDevice(device), fColor(color), fProc(proc), fFills(fills) {}
+
+    void blitH(int x, int y, int w) override {
+        if (fFills) std::fill_n(fDevice.getAddr(x, y), w, fColor);
+        else fProc(x, x + w, y, fDevice, &fColor);
+    }
+
+private:
+    const GBitmap &fDevice;
+    GPixel fColor;
+    BlitzProc fProc;
+    bool fFills;
+};
+
+/*
+ * An opaque shader that replaces the destination: shade straight into the device, no blending and no row buffer.
+ */
+class GOpaqueShaderBlitter : public GBlitter {
+public:
+    GOpaqueShaderBlitter(const GBitmap &device, GShader::Context *context) : fDevice(device), fContext(context) {}
+
+    void blitH(int x, int y, int w) override {
+        fContext->shadeRow(x, y, w, fDevice.getAddr(x, y));
+    }
+
+    void blitSpans(const GSpan spans[], int count) override {
+        GShader::Span batch[kMaxBatchSpans];
+
+        for (int done = 0; done < count; done += kMaxBatchSpans) {
+            int n = std::min((int) kMaxBatchSpans, count - done);
+            for (int i = 0; i < n; i++) {
+                const GSpan &span = spans[done + i];
+                batch[i] = {span.x, span.y, span.w, fDevice.getAddr(span.x, span.y)};
+            }
+
+            fContext->shadeSpans(batch, n);
+        }
+    }
+
+private:
+    const GBitmap &fDevice;
+    GShader::Context *fContext;
+};
+
+/*
+ * Any other shader: shade a row, then blend it into the device.
+ */
+class GShaderBlitter : public GBlitter {
+public:
+    GShaderBlitter(const GBitmap &device, GShader::Context *context, BlitzProc proc)
+            : fDevice(device), fContext(context), fProc(proc) {}
+
+    void blitH(int x, int y, int w) override {
+        GPixel row[w];
+        fContext->shadeRow(x, y, w, row);
+        fProc(x, x + w, y, fDevice, row);
+    }
+
+    // Shade as many spans as fit one after another into a scratch row, then blend each into the device
+    void blitSpans(const GSpan spans[], int count) override {
+        GPixel scratch[kMaxBatchPixels];
+        GShader::Span batch[kMaxBatchSpans];
+        int n = 0, used = 0;
+
+        auto flush = [&]() {
+            fContext->shadeSpans(batch, n);
+            for (int i = 0; i < n; i++)
+                fProc(batch[i].x, batch[i].x + batch[i].count, batch[i].y, fDevice, batch[i].row);
+            n = used = 0;
+        };
+
+        for (int i = 0; i < count; i++) {
+            const GSpan &span = spans[i];
+            if (span.w > kMaxBatchPixels) {
+                blitH(span.x, span.y, span.w);
+                continue;
+            }
+
+            if (n == kMaxBatchSpans || used + span.w > kMaxBatchPixels) flush();
+            batch[n++] = {span.x, span.y, span.w, scratch + used};
+            used += span.w;
+        }
+
+        if (n > 0) flush();
+    }
+
+private:
+    const GBitmap &fDevice;
+    GShader::Context *fContext;
+    BlitzProc fProc;
+};
+
+/*
+ * A shader that is one color along each row: shade a single pixel per row and blit it like a solid color.
+ */
+class GRowColorBlitter : public GBlitter {
+public:
+    GRowColorBlitter(const GBitmap &device, GShader::Context *context, BlitzProc proc, bool fills)
+            : fDevice(device), fContext(context), fProc(proc), fFills(fills) {}
+
+    void blitH(int x, int y, int w) override {
+        GPixel color;
+        fContext->shadeRow(x, y, 1, &color);
+
+        if (fFills) std::fill_n(fDevice.getAddr(x, y), w, color);
+        else fProc(x, x + w, y, fDevice, &color);
+    }
+
+private:
+    const GBitmap &fDevice;
+    GShader::Context *fContext;
+    BlitzProc fProc;
+    bool fFills;
+};
+
+/*
+ * A shader that shades every row the same: keep the columns shaded so far and blit them again on later rows,
+ * shading more only when a span reaches past them.
+ */
+class GRepeatedRowBlitter : public GBlitter {
+public:
+    GRepeatedRowBlitter(const GBitmap &device, GShader::Context *context, BlitzProc proc, bool copies, GArena &arena)
+            : fDevice(device), fContext(context), fProc(proc), fCopies(copies),
+              fRow(arena.makeArray<GPixel>(device.width())) {}
+
+    void blitH(int x, int y, int w) override {
+        const GPixel *src = row(x, y, w);
+
+        if (fCopies) std::copy_n(src, w, fDevice.getAddr(x, y));
+        else fProc(x, x + w, y, fDevice, src);
+    }
+
+private:
+    const GPixel *row(int x, int y, int w) {
+        if (fLeft == fRight || x < fLeft || x + w > fRight) {
+            int left = fLeft == fRight ? x : std::min(x, fLeft);
+            int right = fLeft == fRight ? x + w : std::max(x + w, fRight);
+
+            fContext->shadeRow(left, y, right - left, fRow + left);
+            fLeft = left, fRight = right;
+        }
+
+        return fRow + x;
+    }
+
+    const GBitmap &fDevice;
+    GShader::Context *fContext;
+    BlitzProc fProc;
+    bool fCopies;
+
+    // A device row, shaded so far in columns [fLeft, fRight)
+    GPixel *fRow;
+    int fLeft = 0, fRight = 0;
+};
+
+// The blitter for a shader context which is not a single color
+static GBlitter *choose_shader_blitter(const GBitmap &device, GShader::Context *context, bool opaque, int mode,
+                                       GArena &arena) {
+    const int invariance = context->invariance();
+    if (invariance & GShader::kXInvariant) {
+        BlitzProc proc = opaque ? BlitRow<false>::blend255[mode] : BlitRow<false>::normal_blend[mode];
+        if (proc == BlitRow<false>::blit_row<GBlender::kDst>) return nullptr;
+
+        return arena.make<GRowColorBlitter>(device, context, proc, proc == BlitRow<false>::blit_row<GBlender::kSrc>);
+    }
+
+    if (invariance & GShader::kYInvariant) {
+        BlitzProc proc = opaque ? BlitRow<true>::blend255[mode] : BlitRow<true>::normal_blend[mode];
+        if (proc == BlitRow<true>::blit_row<GBlender::kDst>) return nullptr;
+
+        return arena.make<GRepeatedRowBlitter>(device, context, proc, proc == BlitRow<true>::blit_row<GBlender::kSrc>,
+                                               arena);
+    }
+
+    if (!opaque)
+        return arena.make<GShaderBlitter>(device, context, BlitRow<true>::normal_blend[mode]);
+
+    BlitzProc proc = BlitRow<true>::blend255[mode];
+    if (proc == BlitRow<true>::blit_row<GBlender::kSrc>)
+        return arena.make<GOpaqueShaderBlitter>(device, context);
+
+    return arena.make<GShaderBlitter>(device, context, proc);
+}
+
+GBlitter *GBlitter::Choose(const GBitmap &device, const GPaint &paint, const GMatrix &ctm, GArena &arena) {
+    int mode = (int) paint.getBlendMode();
+    GShader *shader = paint.getShader();
+    GPixel color;
+
+    if (shader != nullptr) {
+        GShader::Context *context = shader->makeContext(ctm, arena);
+        if (context == nullptr) return nullptr;
+
+        // A shader of a single color draws just like a paint of that color
+        std::optional<GPixel> constant = context->constantColor();
+        if (!constant.has_value()) return choose_shader_blitter(device, context, shader->isOpaque(), mode, arena);
+
+        color = *constant;
+    } else {
+        color = gutils::pixelizeFloatColor(paint.getColor());
+    }
+
+    BlitzProc proc;
+
+    if (GPixel_GetA(color) == 255) proc = BlitRow<false>::blend255[mode];
+    else if (GPixel_GetA(color) == 0) proc = BlitRow<false>::blend0[mode];
+    else proc = BlitRow<false>::normal_blend[mode];
+
+    // Leaving the destination alone draws nothing
+    if (proc == BlitRow<false>::blit_row<GBlender::kDst>) return nullptr;
+
+    bool fills = proc == BlitRow<false>::blit_row<GBlender::kSrc> || proc == BlitRow<false>::blit_row<GBlender::kClear>;
+    if (proc == BlitRow<false>::blit_row<GBlender::kClear>) color = 0;
+
+    return arena.make<GSolidBlitter>(device, color, proc, fills);
+}
+
+GMaskBlitter::GMaskBlitter(const GIRect &bounds) : fBounds(bounds) {
+    if (fBounds.isEmpty()) fBounds = GIRect::LTRB(0, 0, 0, 0);
+    fMask.assign((size_t) fBounds.width() * fBounds.height(), 0);
+}
+
+void GMaskBlitter::blitH(int x, int y, int w) {
+    if (y < fBounds.top || y >= fBounds.bottom) return;
+
+    int left = std::max(x, fBounds.left), right = std::min(x + w, fBounds.right);
+    if (left >= right) return;
+
+    uint8_t *row = fMask.data() + (size_t) (y - fBounds.top) * fBounds.width();
+    std::fill(row + left - fBounds.left, row + right - fBounds.left, 255);
+}
+
+uint8_t GMaskBlitter::coverage(int x, int y) const {
+    if (x < fBounds.left || x >= fBounds.right || y < fBounds.top || y >= fBounds.bottom) return 0;
+    return fMask[(size_t) (y - fBounds.top) * fBounds.width() + (x - fBounds.left)];
+}
+
+void GCountingBlitter::blitH(int x, int y, int w) {
+    fSpans += 1;
+    fPixels += w;
+    if (fNext != nullptr) fNext->blitH(x, y, w);
+}
+
+void GCountingBlitter::blitRect(int x, int y, int w, int h) {
+    fSpans += h;
+    fPixels += (int64_t) w * h;
+    if (fNext != nullptr) fNext->blitRect(x, y, w, h);
+}
+
+void GBandBlitter::blitH(int x, int y, int w) {
+    if (y >= fTop && y < fBottom) fNext->blitH(x, y, w);
+}
+
+void GBandBlitter::blitRect(int x, int y, int w, int h) {
+    int top = std::max(y, fTop), bottom = std::min(y + h, fBottom);
+    if (top < bottom) fNext->blitRect(x, top, w, bottom - top);
+}
+
+void GBandBlitter::blitSpans(const GSpan spans[], int count) {
+    // Spans usually come a few neighboring rows at a time, so most batches are wholly inside or outside the band
+    int inside = 0;
+    for (int i = 0; i < count; i++)
+        inside += spans[i].y >= fTop && spans[i].y < fBottom;
+
+    if (inside == count) {
+        fNext->blitSpans(spans, count);
+        return;
+    }
+
+    for (int i = 0; i < count; i++)
+        if (spans[i].y >= fTop && spans[i].y < fBottom) fNext->blitH(spans[i].x, spans[i].y, spans[i].w);
+}
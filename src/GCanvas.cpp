@@ -6,7 +6,6 @@
 #include "../include/GEdge.h"
 #include <vector>
 #include <iostream>
-#include "../include/GBlender.h"
 #include "../shaders/include/GBitmapShader.h"
 #include "../include/GPath.h"
 #include "../include/GUtils.h"
@@ -15,14 +14,25 @@
 #include "../shaders/include/GComposeShader.h"
 #include "../shaders/include/GProxyShader.h"
 #include "../include/GBezier.h"
+#include "../include/GBlitter.h"
+#include "../include/GRegion.h"
+#include "../include/GThreadPool.h"
+#include "../include/GTriangleRasterizer.h"
 #include <numeric>
 
+GCanvas::GCanvas(const GBitmap &device) : fDevice(device), fPool(&GThreadPool::Default()) {
+    transformations.emplace();
+    clips.push({GIRect::WH(device.width(), device.height()), nullptr});
+}
+
 void GCanvas::save() {
     transformations.push(transformations.top());
+    clips.push(clips.top());
 }
 
 void GCanvas::restore() {
     transformations.pop();
+    clips.pop();
 }
 
 void GCanvas::concat(const GMatrix &matrix) {
@@ -41,98 +51,118 @@ void GCanvas::clear(const GColor &color) {
     }
 }
 
-void clip(const std::vector<std::pair<GPoint, GPoint>> &edges, std::vector<Edge> &clipped, int height,
-          int width) {
+/*
+ * Clips the device space segment p1 -> p2 against bounds and appends the resulting edges to clipped.
+ */
+void clip(GPoint p1, GPoint p2, std::vector<Edge> &clipped, const GIRect &bounds) {
+    // Skip edge: If it's horizontal
+    if (GRoundToInt(p1.y) == GRoundToInt(p2.y))
+        return;
 
-    int count = (int) edges.size();
-    clipped.reserve(4 * count);
+    int orientation = (p1.y > p2.y ? 1 : -1);
+    float slope_x, slope_y, intercept_x, intercept_y;
 
-    for (int i = 0; i < count; i++) {
-        GPoint p1 = edges[i].first;
-        GPoint p2 = edges[i].second;
+    // ----------------------------------------------------
 
-        // Skip edge: If it's horizontal
-        if (GRoundToInt(p1.y) == GRoundToInt(p2.y))
-            continue;
+    // < VERTICAL CLIPPING
 
-        int orientation = (p1.y > p2.y ? 1 : -1);
-        float slope_x, slope_y, intercept_x, intercept_y;
+    // Enforce invariant: p1 is always the topmost point of the edge
+    if (p1.y > p2.y)
+        std::swap(p1, p2);
 
-        // ----------------------------------------------------
+    // Skip edge: If it lies completely above or below display
+    if (GRoundToInt(p2.y) <= bounds.top || GRoundToInt(p1.y) >= bounds.bottom) return;
 
-        // < VERTICAL CLIPPING
+    std::tie(slope_x, intercept_x) = gutils::line_properties_x(p1, p2);
 
-        // Enforce invariant: p1 is always the topmost point of the edge
-        if (p1.y > p2.y)
-            std::swap(p1, p2);
+    // New clipped top point
+    float clipped_y1 = std::max((float) bounds.top, p1.y);
+    p1 = {gutils::query_x(clipped_y1, slope_x, intercept_x), clipped_y1};
 
-        // Skip edge: If it lies completely above or below display
-        if ((int) p2.y <= 0 || (int) p1.y >= height) continue;
+    // New clipped top point
+    float clipped_y2 = std::min((float) bounds.bottom, p2.y);
+    p2 = {gutils::query_x(clipped_y2, slope_x, intercept_x), clipped_y2};
 
-        std::tie(slope_x, intercept_x) = gutils::line_properties_x(p1, p2);
+    // <\ VERTICAL CLIPPING
 
-        // New clipped top point
-        float clipped_y1 = std::max(0.0f, p1.y);
-        p1 = {gutils::query_x(clipped_y1, slope_x, intercept_x), clipped_y1};
+    // ----------------------------------------------------
 
-        // New clipped top point
-        float clipped_y2 = std::min((float) height, p2.y);
-        p2 = {gutils::query_x(clipped_y2, slope_x, intercept_x), clipped_y2};
+    // < HORIZONTAL CLIPPING
 
-        // <\ VERTICAL CLIPPING
+    // Enforce invariant: p1 is always leftmost point of the edge
+    if (p1.x > p2.x)
+        std::swap(p1, p2);
 
-        // ----------------------------------------------------
+    float f_left = (float) bounds.left, f_right = (float) bounds.right;
 
-        // < HORIZONTAL CLIPPING
+    std::tie(slope_y, intercept_y) = gutils::line_properties_y(p1, p2);
 
-        // Enforce invariant: p1 is always leftmost point of the edge
-        if (p1.x > p2.x)
-            std::swap(p1, p2);
+    if (p2.x <= f_left) { // Edge lies outside the display, to the left
+        p1 = {f_left, p1.y};
+        p2 = {f_left, p2.y};
 
-        float f_width = (float) width;
+        clipped.emplace_back(p1, p2, orientation);
+    } else if (p1.x >= f_right) { // Edge lies outside the display, to the right
+        p1 = {f_right, p1.y};
+        p2 = {f_right, p2.y};
 
-        std::tie(slope_y, intercept_y) = gutils::line_properties_y(p1, p2);
+        clipped.emplace_back(p1, p2, orientation);
+    } else if (p1.x < f_left && p2.x > f_right) { // Edge fully intersects display, both ends lie outside
+        GPoint left_boundary{f_left, p1.y};
+        GPoint right_boundary{f_right, p2.y};
 
-        if (p2.x <= 0) { // Edge lies outside the display, to the left
-            p1 = {0.0f, p1.y};
-            p2 = {0.0f, p2.y};
+        GPoint clip_left = GPoint{f_left, gutils::query_y(f_left, slope_y, intercept_y)};
+        GPoint clip_right = GPoint{f_right, gutils::query_y(f_right, slope_y, intercept_y)};
 
-            clipped.emplace_back(p1, p2, orientation);
-        } else if (p1.x >= f_width) { // Edge lies outside the display, to the right
-            p1 = {f_width, p1.y};
-            p2 = {f_width, p2.y};
+        clipped.emplace_back(left_boundary, clip_left, orientation);
+        clipped.emplace_back(right_boundary, clip_right, orientation);
+        clipped.emplace_back(clip_left, clip_right, orientation);
+    } else if (p1.x < f_left) { // Left end out of canvas
+        GPoint left_boundary{f_left, p1.y};
+        GPoint clip_left = GPoint{f_left, gutils::query_y(f_left, slope_y, intercept_y)};
 
-            clipped.emplace_back(p1, p2, orientation);
-        } else if (p1.x < 0.0f && p2.y > f_width) { // Edge fully intersects display, both ends lie outside
-            GPoint left_boundary{0.0f, p1.y};
-            GPoint right_boundary{f_width, p2.y};
+        clipped.emplace_back(left_boundary, clip_left, orientation);
+        clipped.emplace_back(clip_left, p2, orientation);
+    } else if (p2.x > f_right) { // Right end out of canvas
+        GPoint right_boundary{f_right, p2.y};
+        GPoint clip_right = GPoint{f_right, gutils::query_y(f_right, slope_y, intercept_y)};
 
-            GPoint clip_left = GPoint{0.0f, gutils::query_y(0.0f, slope_y, intercept_y)};
-            GPoint clip_right = GPoint{f_width, gutils::query_y(f_width, slope_y, intercept_y)};
+        clipped.emplace_back(right_boundary, clip_right, orientation);
+        clipped.emplace_back(p1, clip_right, orientation);
+    } else if (p1.x >= f_left && p2.x <= f_right) { // Both ends in canvas
+        clipped.emplace_back(p1, p2, orientation);
+    }
+    // <\ HORIZONTAL CLIPPING
+}
 
-            clipped.emplace_back(left_boundary, clip_left, orientation);
-            clipped.emplace_back(right_boundary, clip_right, orientation);
-            clipped.emplace_back(clip_left, clip_right, orientation);
-        } else if (p1.x < 0.0f) { // Left end out of canvas
-            GPoint left_boundary{0.0f, p1.y};
-            GPoint clip_left = GPoint{0.0f, gutils::query_y(0.0f, slope_y, intercept_y)};
+/*
+ * Fills a device space rect, covering the same pixels the edge walker would: those whose centers lie inside it.
+ */
+void fill_rect(const GRect &rect, const GIRect &bounds, GBlitter &blitter) {
+    int left = std::max(bounds.left, GRoundToInt(rect.left));
+    int right = std::min(bounds.right, GRoundToInt(rect.right));
+    int top = std::max(bounds.top, GRoundToInt(rect.top));
+    int bottom = std::min(bounds.bottom, GRoundToInt(rect.bottom));
 
-            clipped.emplace_back(left_boundary, clip_left, orientation);
-            clipped.emplace_back(clip_left, p2, orientation);
-        } else if (p2.x > f_width) { // Right end out of canvas
-            GPoint right_boundary{f_width, p2.y};
-            GPoint clip_right = GPoint{f_width, gutils::query_y(f_width, slope_y, intercept_y)};
+    if (left >= right || top >= bottom) return;
 
-            clipped.emplace_back(right_boundary, clip_right, orientation);
-            clipped.emplace_back(p1, clip_right, orientation);
-        } else if (p1.x >= 0.0f && p2.x <= f_width) { // Both ends in canvas
-            clipped.emplace_back(p1, p2, orientation);
-        }
-        // <\ HORIZONTAL CLIPPING
-    }
+    blitter.blitRect(left, top, right - left, bottom - top);
 }
 
 void GCanvas::drawRect(const GRect &rect, const GPaint &paint) {
+    const GMatrix &ctm = transformations.top();
+
+    if (ctm.isScaleTranslate()) {
+        GRect device_rect = ctm.mapRect(rect);
+        if (quickReject(device_rect)) return;
+
+        GArena arena;
+        if (GBlitter *blitter = chooseBlitter(paint, arena))
+            fill_rect(device_rect, clips.top().bounds, *blitter);
+
+        return;
+    }
+
     GPoint vertices[4] = {{rect.left,  rect.top},
                           {rect.right, rect.top},
                           {rect.right, rect.bottom},
@@ -141,308 +171,396 @@ void GCanvas::drawRect(const GRect &rect, const GPaint &paint) {
     drawConvexPolygon(vertices, 4, paint);
 }
 
-void GCanvas::drawConvexPolygon(const GPoint *vertices, int count, const GPaint &paint) {
-    if (count < 2) return;
+/*
+ * Clipping projects the parts of a shape that lie past the left or right side onto that side, so a convex shape
+ * whose top or bottom sticks out leaves vertical edges there that double back over each other. Replace the edges
+ * lying on the boundary x with the rows where their windings don't cancel, which is what the walker expects.
+ */
+void merge_boundary_edges(std::vector<Edge> &edges, float x) {
+    std::vector<std::pair<int, int>> events;
 
-    GPoint new_vertices[count];
+    auto on_boundary = [&](const Edge &edge) {
+        if (edge.tp1.x != x || edge.tp2.x != x) return false;
 
-    for (int i = 0; i < count; i++)
-        new_vertices[i] = transformations.top() * vertices[i];
+        events.emplace_back(edge.top, edge.winding);
+        events.emplace_back(edge.bottom, -edge.winding);
+        return true;
+    };
 
-    std::vector<std::pair<GPoint, GPoint>> init_edges;
-    init_edges.reserve(count + 1);
+    edges.erase(std::remove_if(edges.begin(), edges.end(), on_boundary), edges.end());
+    if (events.empty()) return;
 
-    for (int i = 0; i < count; i++)
-        init_edges.emplace_back(new_vertices[i], new_vertices[(i + 1) % count]);
+    std::sort(events.begin(), events.end());
 
-    std::vector<Edge> clipped;
-    clip(init_edges, clipped, fDevice.height(), fDevice.width());
-    std::sort(clipped.begin(), clipped.end(), [](const Edge &e1, const Edge &e2) {
+    int winding = 0, run_top = 0;
+
+    for (auto [y, delta]: events) {
+        int next_winding = winding + delta;
+
+        if (winding != 0 && next_winding != winding && y > run_top)
+            edges.emplace_back(GPoint{x, (float) run_top}, GPoint{x, (float) y}, winding);
+
+        if (next_winding != winding)
+            run_top = y;
+
+        winding = next_winding;
+    }
+}
+
+/*
+ * Scan converts a convex shape from its clipped edges. Every row crosses exactly two edges, one on the left chain
+ * and one on the right, so after sorting the edges by top we only need to step to the next edge whenever one of
+ * the two runs out: no per row sorting and no winding.
+ */
+void walk_convex(std::vector<Edge> &edges, const GIRect &bounds, GBlitter &blitter) {
+    merge_boundary_edges(edges, (float) bounds.left);
+    merge_boundary_edges(edges, (float) bounds.right);
+
+    int count = (int) edges.size();
+    if (count < 2) return;
+
+    std::sort(edges.begin(), edges.end(), [](const Edge &e1, const Edge &e2) {
         return e1.top < e2.top;
     });
 
-    if ((int) clipped.size() < 2) return;
-
-    int mn = clipped.front().top;
-    int mx = clipped.back().bottom;
+    int top_y = edges.front().top, bottom_y = top_y;
+    for (const auto &edge: edges)
+        bottom_y = std::max(bottom_y, edge.bottom);
 
-    std::pair<int, int> row_bounds[mx - mn + 1];
-    int edge_1 = 0, edge_2 = 1;
+    int edge_1 = 0, edge_2 = 1, next_edge = 2;
 
-    for (int y = mn; y < mx; y++) {
-        if (y >= clipped[edge_1].bottom)
-            edge_1 = std::max(edge_1, edge_2) + 1;
+    for (int y = top_y; y < bottom_y; y++) {
+        while (y >= edges[edge_1].bottom) {
+            if (next_edge == count) return;
+            edge_1 = next_edge++;
+        }
 
-        if (y >= clipped[edge_2].bottom)
-            edge_2 = std::max(edge_1, edge_2) + 1;
+        while (y >= edges[edge_2].bottom) {
+            if (next_edge == count) return;
+            edge_2 = next_edge++;
+        }
 
         float laser = (float) y + 0.5f;
 
-        int q1 = clipped[edge_1].query_x_round(laser);
-        int q2 = clipped[edge_2].query_x_round(laser);
+        int q1 = edges[edge_1].query_x_round(laser);
+        int q2 = edges[edge_2].query_x_round(laser);
 
         if (q1 > q2)
             std::swap(q1, q2);
 
-        row_bounds[y - mn].first = q1;
-        row_bounds[y - mn].second = q2;
+        if (q1 < q2)
+            blitter.blitH(q1, y, q2 - q1);
     }
+}
 
-    auto mode = paint.getBlendMode();
-
-    // If we have a shader, then we blend each pixel individually
-    GShader *shader = paint.getShader();
-    if (shader != nullptr) {
-        if (!shader->setContext(transformations.top())) return;
-
-        if (shader->isOpaque()) {
-            for (int y = mn; y < mx; y++) {
-                int left = row_bounds[y - mn].first;
-                int right = row_bounds[y - mn].second;
-                int len = right - left + 1;
+void GCanvas::drawConvexPolygon(const GPoint *vertices, int count, const GPaint &paint) {
+    if (count < 2) return;
 
-                GPixel row[len];
-                shader->shadeRow(left, y, len, row);
-                BlitRow<true>::blend255[(int) mode](left, right, y, fDevice, row);
-            }
-        } else {
-            for (int y = mn; y < mx; y++) {
-                int left = row_bounds[y - mn].first;
-                int right = row_bounds[y - mn].second;
-                int len = right - left + 1;
-
-                GPixel row[len];
-                shader->shadeRow(left, y, len, row);
-                BlitRow<true>::normal_blend[(int) mode](left, right, y, fDevice, row);
-            }
-        }
+    GPoint new_vertices[count];
 
-        return;
-    }
+    GRect device_bounds = GRect::LTRB(INFINITY, INFINITY, -INFINITY, -INFINITY);
+    for (int i = 0; i < count; i++) {
+        new_vertices[i] = transformations.top() * vertices[i];
 
-    GPixel src[1] = {gutils::pixelizeFloatColor(paint.getColor())};
-    if (GPixel_GetA(*src) == 255) {
-        for (int y = mn; y < mx; y++)
-            BlitRow<false>::blend255[(int) mode](row_bounds[y - mn].first, row_bounds[y - mn].second, y, fDevice, src);
-    } else if (GPixel_GetA(*src) == 0) {
-        for (int y = mn; y < mx; y++)
-            BlitRow<false>::blend0[(int) mode](row_bounds[y - mn].first, row_bounds[y - mn].second, y, fDevice, src);
-    } else {
-        for (int y = mn; y < mx; y++)
-            BlitRow<false>::normal_blend[(int) mode](row_bounds[y - mn].first, row_bounds[y - mn].second, y, fDevice,
-                                                     src);
+        device_bounds.left = std::min(device_bounds.left, new_vertices[i].x);
+        device_bounds.top = std::min(device_bounds.top, new_vertices[i].y);
+        device_bounds.right = std::max(device_bounds.right, new_vertices[i].x);
+        device_bounds.bottom = std::max(device_bounds.bottom, new_vertices[i].y);
     }
-}
 
-void createQuad(std::vector<std::pair<GPoint, GPoint>> &edges, float tolerance, GPoint *points) {
-    GPoint error_vec = (points[0] - 2.0f * points[1] + points[2]) * 0.25f;
-    int num_segments = (int) ceil(sqrt(sqrt(error_vec.x * error_vec.x + error_vec.y * error_vec.y) / tolerance));
-    float inv = 1.0f / (float) num_segments;
-    GPoint prev_point = bezier::eval_quad(0.0f, points);
-    float cur_t = inv;
+    if (quickReject(device_bounds)) return;
 
-    for (int segment = 0; segment < num_segments; segment++) {
-        GPoint cur = bezier::eval_quad(cur_t, points);
-        edges.emplace_back(prev_point, cur);
-        cur_t += inv;
-        prev_point = cur;
-    }
-}
+    const GIRect &bounds = clips.top().bounds;
 
-void createCubic(std::vector<std::pair<GPoint, GPoint>> &edges, float tolerance, GPoint *points) {
-    GPoint error_vec0 = points[0] - 2 * points[1] + points[2];
-    GPoint error_vec1 = points[1] - 2 * points[2] + points[3];
+    std::vector<Edge> clipped;
+    clipped.reserve(4 * count);
 
-    GPoint res{std::max(abs(error_vec0.x), abs(error_vec1.x)),
-               std::max(abs(error_vec0.y), abs(error_vec1.y))};
+    for (int i = 0; i < count; i++)
+        clip(new_vertices[i], new_vertices[(i + 1) % count], clipped, bounds);
 
-    int num_segments = (int) ceil(sqrt((3 * sqrt(res.x * res.x + res.y * res.y)) / (4 * tolerance)));
+    if ((int) clipped.size() < 2) return;
 
-    float inv = 1.0f / (float) num_segments;
-    GPoint prev_point = bezier::eval_cubic(0.0f, points);
-    float cur_t = inv;
+    GArena arena;
+    GBlitter *blitter = chooseBlitter(paint, arena);
+    if (blitter == nullptr) return;
 
-    for (int segment = 0; segment < num_segments; segment++) {
-        GPoint cur = bezier::eval_cubic(cur_t, points);
-        edges.emplace_back(prev_point, cur);
-        cur_t += inv;
-        prev_point = cur;
-    }
+    walk_convex(clipped, bounds, *blitter);
 }
 
-void GCanvas::drawPath(const GPath &path, const GPaint &paint) {
-    GPath new_path = path;
-    new_path.transform(transformations.top());
+enum OutCode {
+    kInside = 0,
+    kLeft = 1,
+    kRight = 2,
+    kTop = 4,
+    kBottom = 8,
+};
 
-    GPoint points[GPath::kMaxNextPoints];
-    GPath::Edger edger(new_path);
+int out_code(GPoint p, const GRect &bounds) {
+    int code = kInside;
 
-    std::vector<std::pair<GPoint, GPoint>> init_edges;
-    init_edges.reserve(path.countPoints());
+    if (p.x < bounds.left) code |= kLeft;
+    else if (p.x > bounds.right) code |= kRight;
 
-    std::vector<Edge> clipped;
+    if (p.y < bounds.top) code |= kTop;
+    else if (p.y > bounds.bottom) code |= kBottom;
 
-    while (const auto verb = edger.next(points)) {
-        switch (verb.value()) {
-            case GPath::kLine:
-                init_edges.emplace_back(points[0], points[1]);
-                break;
-            case GPath::kQuad:
-                createQuad(init_edges, 0.25f, points);
-                break;
-            case GPath::kCubic:
-                createCubic(init_edges, 0.25f, points);
-                break;
-            case GPath::kMove:
-                break;
+    return code;
+}
+
+/*
+ * Cohen-Sutherland: clips the segment p0 -> p1 to bounds.
+ * Returns false if no part of the segment is inside.
+ */
+bool clip_line(GPoint &p0, GPoint &p1, const GRect &bounds) {
+    int code0 = out_code(p0, bounds);
+    int code1 = out_code(p1, bounds);
+
+    while (true) {
+        if (!(code0 | code1)) return true;
+        if (code0 & code1) return false;
+
+        // Move the end point that lies outside onto the boundary it crosses
+        int code = code0 ? code0 : code1;
+        GPoint p{};
+
+        if (code & kBottom) {
+            p = {p0.x + (p1.x - p0.x) * (bounds.bottom - p0.y) / (p1.y - p0.y), bounds.bottom};
+        } else if (code & kTop) {
+            p = {p0.x + (p1.x - p0.x) * (bounds.top - p0.y) / (p1.y - p0.y), bounds.top};
+        } else if (code & kRight) {
+            p = {bounds.right, p0.y + (p1.y - p0.y) * (bounds.right - p0.x) / (p1.x - p0.x)};
+        } else {
+            p = {bounds.left, p0.y + (p1.y - p0.y) * (bounds.left - p0.x) / (p1.x - p0.x)};
+        }
+
+        if (code == code0) {
+            p0 = p;
+            code0 = out_code(p0, bounds);
+        } else {
+            p1 = p;
+            code1 = out_code(p1, bounds);
         }
     }
+}
 
-    clip(init_edges, clipped, fDevice.height(), fDevice.width());
+void GCanvas::drawLine(GPoint p0, GPoint p1, const GPaint &paint) {
+    p0 = transformations.top() * p0;
+    p1 = transformations.top() * p1;
 
-    if ((int) clipped.size() < 2) return;
+    const GIRect &bounds = clips.top().bounds;
+    GRect f_bounds = GRect::LTRB((float) bounds.left, (float) bounds.top, (float) bounds.right, (float) bounds.bottom);
+    if (bounds.isEmpty() || !clip_line(p0, p1, f_bounds)) return;
 
-    std::sort(clipped.begin(), clipped.end(), [](const Edge &e1, const Edge &e2) {
-        return e1.top < e2.top;
-    });
+    GArena arena;
+    GBlitter *blitter = chooseBlitter(paint, arena);
+    if (blitter == nullptr) return;
 
-    GShader *shader = paint.getShader();
+    float dx = p1.x - p0.x, dy = p1.y - p0.y;
 
-    if (shader != nullptr) {
-        if (!shader->setContext(transformations.top())) return;
-        if (shader->isOpaque())
-            drawPath<true, 255>(clipped, paint);
-        else
-            drawPath<true, -1>(clipped, paint);
+    // DDA: take one step per pixel along the major axis, sampling the minor axis at pixel centers
+    if (std::abs(dx) >= std::abs(dy)) {
+        if (p0.x > p1.x) std::swap(p0, p1);
 
-        return;
-    }
+        int x_start = GRoundToInt(p0.x), x_end = std::min(GRoundToInt(p1.x), bounds.right);
+        if (x_start >= x_end) return;
 
-    GPixel src[1] = {gutils::pixelizeFloatColor(paint.getColor())};
-    switch (GPixel_GetA(*src)) {
-        case 255:
-            drawPath<false, 255>(clipped, paint);
-            break;
-        case 0:
-            drawPath<false, 0>(clipped, paint);
-        default:
-            drawPath<false, -1>(clipped, paint);
-    }
-}
+        float slope = dy / dx;
+        float y = p0.y + ((float) x_start + 0.5f - p0.x) * slope;
 
-void GCanvas::drawMesh(const GPoint *verts, const GColor *colors, const GPoint *texs, int count, const int *indices,
-                        const GPaint &paint) {
-    if (colors != nullptr && texs == nullptr) {
-        for (int i = 0, n = 0; i < count; i++, n += 3) {
-            GPoint draw_verts[3] = {verts[indices[n]], verts[indices[n + 1]], verts[indices[n + 2]]};
-            GColor draw_colors[3] = {colors[indices[n]], colors[indices[n + 1]], colors[indices[n + 2]]};
+        // Neighbouring pixels in the same row are blitted together as one span
+        int run_start = x_start;
+        int run_y = std::max(bounds.top, std::min(GFloorToInt(y), bounds.bottom - 1));
 
-            auto shader = GCreateTriangleGradient(draw_verts, draw_colors);
-            GPaint my_paint{shader.get()};
+        for (int x = x_start + 1; x < x_end; x++) {
+            y += slope;
+            int row = std::max(bounds.top, std::min(GFloorToInt(y), bounds.bottom - 1));
 
-            drawConvexPolygon(draw_verts, 3, my_paint);
+            if (row != run_y) {
+                blitter->blitH(run_start, run_y, x - run_start);
+                run_start = x;
+                run_y = row;
+            }
         }
-    }
-
-    if (texs != nullptr) {
-        for (int i = 0, n = 0; i < count; i++, n += 3) {
-            GPoint draw_verts[3] = {verts[indices[n]], verts[indices[n + 1]], verts[indices[n + 2]]};
-            GPoint draw_texs[3] = {texs[indices[n]], texs[indices[n + 1]], texs[indices[n + 2]]};
 
-            GMatrix draw_mapper = gutils::compute_triangle_basis(draw_verts);
-            GMatrix payload_mapper = gutils::compute_triangle_basis(draw_texs);
+        blitter->blitH(run_start, run_y, x_end - run_start);
+    } else {
+        if (p0.y > p1.y) std::swap(p0, p1);
 
-            auto proxy_shader = GCreateProxyShader(*paint.getShader(), draw_mapper * payload_mapper.invert().value());
-            GPaint my_paint{};
+        int y_start = GRoundToInt(p0.y), y_end = std::min(GRoundToInt(p1.y), bounds.bottom);
+        float slope = dx / dy;
+        float x = p0.x + ((float) y_start + 0.5f - p0.y) * slope;
 
-            if (colors != nullptr) {
-                GColor draw_colors[3] = {colors[indices[n]], colors[indices[n + 1]], colors[indices[n + 2]]};
+        for (int y = y_start; y < y_end; y++) {
+            int col = std::max(bounds.left, std::min(GFloorToInt(x), bounds.right - 1));
+            blitter->blitH(col, y, 1);
+            x += slope;
+        }
+    }
+}
 
-                auto gradient_shader = GCreateTriangleGradient(draw_verts, draw_colors);
-                auto compose_shader = GCreateTriangleCompose(*gradient_shader, *proxy_shader);
-                my_paint.setShader(compose_shader.get());
-                drawConvexPolygon(draw_verts, 3, my_paint);
-            } else {
-                my_paint.setShader(proxy_shader.get());
-                drawConvexPolygon(draw_verts, 3, my_paint);
-            }
+/*
+ * Fills a device space rect with elliptical corners of radii rx, ry, already clamped to half the rect. A row whose
+ * center is dy beyond the start of a corner reaches out w = sqrt(k (ry^2 - dy^2)) from the corner's center column,
+ * k = (rx / ry)^2. Like the edge walker, a pixel is covered when its center is inside.
+ *
+ * Rather than take the square root, each end of the span is stepped from the previous row's: a column further out is
+ * covered when its center is within w, which compares squares. From one row to the next the ends move by about as
+ * many columns as the arc's slope, so over a whole corner this is a step per column or row it spans.
+ */
+void fill_rrect(const GRect &rect, float rx, float ry, const GIRect &bounds, GBlitter &blitter) {
+    int top = std::max(bounds.top, GRoundToInt(rect.top));
+    int bottom = std::min(bounds.bottom, GRoundToInt(rect.bottom));
+    if (top >= bottom) return;
+
+    // Rows between the corners are full width; corners are symmetric about the rect's middle row
+    float inner_top = rect.top + ry, inner_bottom = rect.bottom - ry;
+    float k = rx * rx / (ry * ry);
+
+    // The corners' center columns, and the span [l, r) they reach on the current row
+    const float center_l = rect.left + rx, center_r = rect.right - rx;
+    int l = GRoundToInt(center_l), r = GRoundToInt(center_r);
+
+    float center_y = (float) top + 0.5f;
+    for (int y = top; y < bottom; y++, center_y += 1.0f) {
+        float dy = std::max(inner_top - center_y, center_y - inner_bottom);
+
+        if (dy <= 0.0f) {
+            l = GRoundToInt(rect.left);
+            r = GRoundToInt(rect.right);
+        } else {
+            float w_sq = k * (ry * ry - dy * dy);
+            if (w_sq <= 0.0f) continue;
+
+            // Column l - 1 is covered when its center, d left of the corner's center column, is within w; the
+            // right end likewise, mirrored
+            auto out_l = [&]() { float d = center_l - (float) l + 0.5f; return d < 0.0f || d * d < w_sq; };
+            auto in_l = [&]() { float d = center_l - (float) l - 0.5f; return d >= 0.0f && d * d >= w_sq; };
+            auto out_r = [&]() { float d = (float) r + 0.5f - center_r; return d <= 0.0f || d * d <= w_sq; };
+            auto in_r = [&]() { float d = (float) r - 0.5f - center_r; return d > 0.0f && d * d > w_sq; };
+
+            while (out_l()) l--;
+            while (in_l()) l++;
+            while (out_r()) r++;
+            while (in_r()) r--;
         }
+
+        int left = std::max(bounds.left, l), right = std::min(bounds.right, r);
+        if (left < right)
+            blitter.blitH(left, y, right - left);
     }
 }
 
-template<typename T>
-T interpolate(float s, float t, T *payload) {
-    return payload[0] * (1 - s) * (1 - t) +
-           payload[1] * s * (1 - t) +
-           payload[2] * (1 - s) * t +
-           payload[3] * s * t;
+/*
+ * The same shape as a path, for CTMs that don't keep it axis-aligned. Corners are cubic approximations of quarter
+ * ellipses, matching GPath::addCircle.
+ */
+GPath rrect_path(const GRect &rect, float rx, float ry) {
+    const float kappa = 0.551915f;
+    float kx = rx * (1.0f - kappa), ky = ry * (1.0f - kappa);
+    float l = rect.left, t = rect.top, r = rect.right, b = rect.bottom;
+
+    GPath path;
+    path.reserve(13, 9);
+    path.moveTo(l + rx, t);
+    path.lineTo(r - rx, t);
+    path.cubicTo(r - kx, t, r, t + ky, r, t + ry);
+    path.lineTo(r, b - ry);
+    path.cubicTo(r, b - ky, r - kx, b, r - rx, b);
+    path.lineTo(l + rx, b);
+    path.cubicTo(l + kx, b, l, b - ky, l, b - ry);
+    path.lineTo(l, t + ry);
+    path.cubicTo(l, t + ky, l + kx, t, l + rx, t);
+    return path;
 }
 
-void GCanvas::drawQuad(const GPoint *verts, const GColor *colors, const GPoint *texs, int level, const GPaint &paint) {
-    int point_cnt = level + 2;
+void GCanvas::drawRRect(const GRect &rect, float rx, float ry, const GPaint &paint) {
+    GRect sorted = GRect::LTRB(std::min(rect.left, rect.right), std::min(rect.top, rect.bottom),
+                               std::max(rect.left, rect.right), std::max(rect.top, rect.bottom));
+    if (sorted.isEmpty()) return;
 
-    std::vector<GPoint> draw_points;
-    draw_points.reserve(std::min(4, (point_cnt + 1) * (point_cnt + 1)));
+    rx = std::min(std::max(rx, 0.0f), sorted.width() * 0.5f);
+    ry = std::min(std::max(ry, 0.0f), sorted.height() * 0.5f);
 
-    std::vector<GColor> draw_colors;
-    draw_colors.reserve(std::min(4, (point_cnt + 1) * (point_cnt + 1)));
+    if (rx == 0.0f || ry == 0.0f) {
+        drawRect(sorted, paint);
+        return;
+    }
 
-    std::vector<GPoint> draw_texs;
-    draw_texs.reserve(std::min(4, (point_cnt + 1) * (point_cnt + 1)));
+    const GMatrix &ctm = transformations.top();
 
-    std::vector<int> indices;
-    indices.reserve(std::min(12, (point_cnt + 1) * (point_cnt) * 3));
+    if (!ctm.isScaleTranslate()) {
+        drawPath(rrect_path(sorted, rx, ry), paint);
+        return;
+    }
 
-    float step_size = 1.0f / (float) (level + 1);
+    GRect device_rect = ctm.mapRect(sorted);
+    if (quickReject(device_rect)) return;
 
-    float t = 0;
-    for (int i = 0; i < point_cnt; i++) {
-        float s = 0;
-        for (int j = 0; j < point_cnt; j++) {
-            GPoint verts_payload[4] = {verts[0], verts[1], verts[3], verts[2]};
-            draw_points.emplace_back(interpolate<GPoint>(s, t, verts_payload));
+    GArena arena;
+    GBlitter *blitter = chooseBlitter(paint, arena);
+    if (blitter == nullptr) return;
 
-            if (texs != nullptr) {
-                GPoint texs_payload[4] = {texs[0], texs[1], texs[3], texs[2]};
-                draw_texs.emplace_back(interpolate<GPoint>(s, t, texs_payload));
-            }
+    fill_rrect(device_rect, rx * std::abs(ctm[0]), ry * std::abs(ctm[3]), clips.top().bounds, *blitter);
+}
 
-            if (colors != nullptr) {
-                GColor colors_payload[4] = {colors[0], colors[1], colors[3], colors[2]};
-                draw_colors.emplace_back(interpolate<GColor>(s, t, colors_payload));
-            }
+void GCanvas::drawOval(const GRect &rect, const GPaint &paint) {
+    drawRRect(rect, std::abs(rect.width()) * 0.5f, std::abs(rect.height()) * 0.5f, paint);
+}
 
-            s += step_size;
-        }
+void GCanvas::drawCircle(GPoint center, float radius, const GPaint &paint) {
+    radius = std::abs(radius);
+    drawOval(GRect::LTRB(center.x - radius, center.y - radius, center.x + radius, center.y + radius), paint);
+}
+
+/*
+ * Flattens the quadratic into line segments within the given tolerance, passing each one to emit_line.
+ */
+template<typename LineProc>
+void createQuad(const GPoint *points, float tolerance, LineProc &&emit_line) {
+    GPoint error_vec = (points[0] - 2.0f * points[1] + points[2]) * 0.25f;
+    int num_segments = (int) ceil(sqrt(sqrt(error_vec.x * error_vec.x + error_vec.y * error_vec.y) / tolerance));
+    float inv = 1.0f / (float) num_segments;
+    GPoint prev_point = bezier::eval_quad(0.0f, points);
+    float cur_t = inv;
 
-        t += step_size;
+    for (int segment = 0; segment < num_segments; segment++) {
+        GPoint cur = bezier::eval_quad(cur_t, points);
+        emit_line(prev_point, cur);
+        cur_t += inv;
+        prev_point = cur;
     }
+}
 
-    for (int i = 0; i < point_cnt - 1; i++) {
-        for (int j = 0; j < point_cnt; j++) {
-            int cur_idx = i * point_cnt + j;
+/*
+ * Flattens the cubic into line segments within the given tolerance, passing each one to emit_line.
+ */
+template<typename LineProc>
+void createCubic(const GPoint *points, float tolerance, LineProc &&emit_line) {
+    GPoint error_vec0 = points[0] - 2 * points[1] + points[2];
+    GPoint error_vec1 = points[1] - 2 * points[2] + points[3];
 
-            if (j < point_cnt - 1) {
-                indices.push_back(cur_idx);
-                indices.push_back(cur_idx + 1);
-                indices.push_back(cur_idx + point_cnt);
-            }
+    GPoint res{std::max(abs(error_vec0.x), abs(error_vec1.x)),
+               std::max(abs(error_vec0.y), abs(error_vec1.y))};
 
-            if (j >= 1) {
-                indices.push_back(cur_idx);
-                indices.push_back(cur_idx + point_cnt - 1);
-                indices.push_back(cur_idx + point_cnt);
-            }
+    int num_segments = (int) ceil(sqrt((3 * sqrt(res.x * res.x + res.y * res.y)) / (4 * tolerance)));
 
-        }
-    }
+    float inv = 1.0f / (float) num_segments;
+    GPoint prev_point = bezier::eval_cubic(0.0f, points);
+    float cur_t = inv;
 
-    drawMesh(draw_points.data(), (colors == nullptr ? nullptr : draw_colors.data()),
-             (texs == nullptr ? nullptr : draw_texs.data()), (int) indices.size() / 3, indices.data(), paint);
+    for (int segment = 0; segment < num_segments; segment++) {
+        GPoint cur = bezier::eval_cubic(cur_t, points);
+        emit_line(prev_point, cur);
+        cur_t += inv;
+        prev_point = cur;
+    }
 }
 
-template<bool has_shader, int alpha>
-void GCanvas::drawPath(std::vector<Edge> &clipped, const GPaint &paint) {
+/*
+ * Scan converts any shape from its clipped edges, sorted by top: each row crosses the active edges in x order, and
+ * the spans between them where the winding is non-zero are filled.
+ */
+void walk_edges(std::vector<Edge> &clipped, GBlitter &blitter) {
     int top_y = clipped.front().top;
     int bottom_y = clipped.back().bottom;
     for (const auto &edge: clipped) {
@@ -458,10 +576,6 @@ void GCanvas::drawPath(std::vector<Edge> &clipped, const GPaint &paint) {
     std::vector<std::pair<int, int>> x_vals;
     x_vals.reserve(num_edges);
 
-    GShader *shader = paint.getShader();
-    int mode = (int) paint.getBlendMode();
-    GPixel src[1] = {gutils::pixelizeFloatColor(paint.getColor())};
-
     int start_idx = 0;
 
     for (int y = top_y; y < bottom_y; y++) {
@@ -512,29 +626,373 @@ void GCanvas::drawPath(std::vector<Edge> &clipped, const GPaint &paint) {
             if (cur_winding == 0) {
                 r = x;
 
-                if (shader != nullptr) {
-                    int len = r - l + 1;
-                    GPixel row[len];
-                    shader->shadeRow(l, y, len, row);
-
-                    if (alpha == 255)
-                        BlitRow<true>::blend255[mode](l, r, y, fDevice, row);
-                    else
-                        BlitRow<true>::normal_blend[mode](l, r, y, fDevice, row);
-                } else {
-                    if (alpha == 255) {
-                        BlitRow<false>::blend255[(int) mode](l, r, y, fDevice, src);
-                    } else if (alpha == 0) {
-                        BlitRow<false>::blend0[(int) mode](l, r, y, fDevice, src);
-                    } else {
-                        BlitRow<true>::normal_blend[(int) mode](l, r, y, fDevice, src);
-                    }
-                }
+                if (l < r)
+                    blitter.blitH(l, y, r - l);
             }
         }
     }
 }
 
+void GCanvas::drawPath(const GPath &path, const GPaint &paint) {
+    if (quickReject(transformations.top().mapRect(path.controlBounds()))) return;
+
+    GArena arena;
+    GBlitter *blitter = chooseBlitter(paint, arena);
+    if (blitter == nullptr) return;
+
+    scanPath(path, *blitter);
+}
+
+void GCanvas::drawPath(const GPath &path, GBlitter &blitter) {
+    GArena arena;
+    scanPath(path, *clipBlitter(&blitter, arena));
+}
+
+void GCanvas::clipRect(const GRect &rect) {
+    const GMatrix &ctm = transformations.top();
+
+    if (!ctm.isScaleTranslate()) {
+        GPath path;
+        path.addRect(rect);
+        clipPath(path);
+        return;
+    }
+
+    // Keep the pixels whose centers are inside, like fill_rect
+    GRect device_rect = ctm.mapRect(rect);
+    GIRect rounded = GIRect::LTRB(GRoundToInt(device_rect.left), GRoundToInt(device_rect.top),
+                                  GRoundToInt(device_rect.right), GRoundToInt(device_rect.bottom));
+
+    ClipState &clip = clips.top();
+
+    if (clip.region != nullptr) {
+        setClip(clip.region->intersect(GRegion(rounded)));
+        return;
+    }
+
+    clip.bounds = GIRect::LTRB(std::max(clip.bounds.left, rounded.left), std::max(clip.bounds.top, rounded.top),
+                               std::min(clip.bounds.right, rounded.right),
+                               std::min(clip.bounds.bottom, rounded.bottom));
+    if (clip.bounds.isEmpty())
+        clip.bounds = GIRect::LTRB(0, 0, 0, 0);
+}
+
+void GCanvas::clipPath(const GPath &path) {
+    ClipState &clip = clips.top();
+
+    // The path is only rasterized inside the current bounds, so it only needs intersecting with a region
+    GRegion::Builder builder;
+    if (!quickReject(transformations.top().mapRect(path.controlBounds())))
+        scanPath(path, builder);
+
+    GRegion region = builder.detach();
+    setClip(clip.region != nullptr ? clip.region->intersect(region) : std::move(region));
+}
+
+GIRect GCanvas::getClipBounds() const {
+    return clips.top().bounds;
+}
+
+void GCanvas::setClip(GRegion &&region) {
+    ClipState &clip = clips.top();
+
+    clip.bounds = region.bounds();
+    clip.region = region.isRect() ? nullptr : std::make_shared<const GRegion>(std::move(region));
+}
+
+bool GCanvas::quickReject(const GRect &deviceBounds) const {
+    const GIRect &bounds = clips.top().bounds;
+
+    return bounds.isEmpty() ||
+           deviceBounds.right <= (float) bounds.left || deviceBounds.bottom <= (float) bounds.top ||
+           deviceBounds.left >= (float) bounds.right || deviceBounds.top >= (float) bounds.bottom;
+}
+
+GBlitter *GCanvas::chooseBlitter(const GPaint &paint, GArena &arena) {
+    if (clips.top().bounds.isEmpty()) return nullptr;
+
+    return clipBlitter(GBlitter::Choose(fDevice, paint, transformations.top(), arena), arena);
+}
+
+GBlitter *GCanvas::clipBlitter(GBlitter *blitter, GArena &arena) {
+    const ClipState &clip = clips.top();
+
+    if (blitter == nullptr || clip.region == nullptr) return blitter;
+    return arena.make<GRegionBlitter>(*clip.region, blitter);
+}
+
+void GCanvas::scanPath(const GPath &path, GBlitter &blitter) {
+    // Quick reject: nothing to do if the path lands entirely outside the clip
+    GRect device_bounds = transformations.top().mapRect(path.controlBounds());
+    if (quickReject(device_bounds)) return;
+
+    const GIRect &bounds = clips.top().bounds;
+
+    // Rects under a scale/translate CTM stay rects, and need no edges at all
+    GRect rect;
+    if (transformations.top().isScaleTranslate() && path.isRect(&rect)) {
+        fill_rect(device_bounds, bounds, blitter);
+        return;
+    }
+
+    // Map points through the CTM as we walk, rather than transforming a copy of the path
+    GPoint points[GPath::kMaxNextPoints];
+    GPath::Edger edger(path, transformations.top());
+
+    std::vector<Edge> clipped;
+    clipped.reserve(path.countPoints());
+
+    auto emit_line = [&](GPoint p1, GPoint p2) {
+        clip(p1, p2, clipped, bounds);
+    };
+
+    while (const auto verb = edger.next(points)) {
+        switch (verb.value()) {
+            case GPath::kLine:
+                emit_line(points[0], points[1]);
+                break;
+            case GPath::kQuad:
+                createQuad(points, 0.25f, emit_line);
+                break;
+            case GPath::kCubic:
+                createCubic(points, 0.25f, emit_line);
+                break;
+            case GPath::kMove:
+                break;
+        }
+    }
+
+    if ((int) clipped.size() < 2) return;
+
+    // Single convex contours can skip the general winding scan
+    if (path.isConvex()) {
+        walk_convex(clipped, bounds, blitter);
+        return;
+    }
+
+    std::sort(clipped.begin(), clipped.end(), [](const Edge &e1, const Edge &e2) {
+        return e1.top < e2.top;
+    });
+
+    walk_edges(clipped, blitter);
+}
+
+/*
+ * What drawMesh needs to know about each triangle, worked out in one pass before any of them are drawn: its device
+ * space corners and colors, and the matrix taking texture coordinates onto its corners.
+ */
+struct MeshTriangle {
+    GPoint pts[3];
+    GColor colors[3];
+    GMatrix tex_to_device;
+    // Device rows [top, bottom) that the triangle may cover
+    int top, bottom;
+};
+
+enum {
+    // Rows in each band when a mesh is split across threads
+    kMeshBandHeight = 32,
+    // Meshes with fewer triangles aren't worth waking the pool for
+    kMinParallelTriangles = 256,
+};
+
+void GCanvas::drawMesh(const GPoint *verts, const GColor *colors, const GPoint *texs, int count, const int *indices,
+                        const GPaint &paint) {
+    if (count <= 0 || (colors == nullptr && texs == nullptr)) return;
+    if (texs != nullptr && paint.getShader() == nullptr) return;
+
+    // Map every vertex once, however many triangles share it
+    int vertex_count = *std::max_element(indices, indices + 3 * count) + 1;
+    std::vector<GPoint> device_verts(vertex_count);
+    transformations.top().mapPoints(device_verts.data(), verts, vertex_count);
+
+    std::vector<MeshTriangle> triangles;
+    triangles.reserve(count);
+
+    for (int n = 0; n < 3 * count; n += 3) {
+        MeshTriangle tri;
+        const int *index = indices + n;
+
+        GRect device_bounds = GRect::LTRB(INFINITY, INFINITY, -INFINITY, -INFINITY);
+        for (int k = 0; k < 3; k++) {
+            tri.pts[k] = device_verts[index[k]];
+            if (colors != nullptr) tri.colors[k] = colors[index[k]];
+
+            device_bounds.left = std::min(device_bounds.left, tri.pts[k].x);
+            device_bounds.top = std::min(device_bounds.top, tri.pts[k].y);
+            device_bounds.right = std::max(device_bounds.right, tri.pts[k].x);
+            device_bounds.bottom = std::max(device_bounds.bottom, tri.pts[k].y);
+        }
+
+        if (quickReject(device_bounds)) continue;
+
+        // Slivers that fall between pixel centers cover nothing (the slack allows for the rasterizer snapping
+        // corners to 1/256 of a pixel), which in finely divided meshes is most triangles
+        const float slack = 1.0f / 256;
+        if (GFloorToInt(device_bounds.right - 0.5f + slack) < GCeilToInt(device_bounds.left - 0.5f - slack) ||
+            GFloorToInt(device_bounds.bottom - 0.5f + slack) < GCeilToInt(device_bounds.top - 0.5f - slack))
+            continue;
+
+        tri.top = GFloorToInt(device_bounds.top);
+        tri.bottom = GCeilToInt(device_bounds.bottom);
+
+        if (texs != nullptr) {
+            GPoint tex_pts[3] = {texs[index[0]], texs[index[1]], texs[index[2]]};
+
+            auto tex_inv = gutils::compute_triangle_basis(tex_pts).invert();
+            if (!tex_inv.has_value()) continue;
+
+            tri.tex_to_device = gutils::compute_triangle_basis(tri.pts) * tex_inv.value();
+        }
+
+        triangles.push_back(tri);
+    }
+
+    const GIRect &bounds = clips.top().bounds;
+
+    // Draws the triangle's rows in [top, bottom)
+    auto draw_triangle = [&](const MeshTriangle &tri, int top, int bottom) {
+        // The triangle is already in device space, so its shaders see an identity CTM
+        std::optional<GTriangleGradientShader> gradient;
+        std::optional<GProxyShader> proxy;
+        std::optional<GComposeShader> compose;
+        GPaint tri_paint = paint;
+
+        if (colors != nullptr)
+            tri_paint.setShader(&gradient.emplace(tri.pts, tri.colors));
+
+        if (texs != nullptr) {
+            tri_paint.setShader(&proxy.emplace(*paint.getShader(), tri.tex_to_device));
+            if (colors != nullptr) tri_paint.setShader(&compose.emplace(*gradient, *proxy));
+        }
+
+        GArena arena;
+        GBlitter *blitter = clipBlitter(GBlitter::Choose(fDevice, tri_paint, GMatrix(), arena), arena);
+        if (blitter == nullptr) return;
+
+        GIRect area = GIRect::LTRB(bounds.left, std::max(top, bounds.top), bounds.right, std::min(bottom, bounds.bottom));
+        if (GRasterizeTriangle(tri.pts, area, *blitter)) return;
+
+        // Corners too far out for the edge functions go through the polygon scanner, which would cut its edges
+        // differently at a band's top and bottom, so the band drops rows instead
+        std::vector<Edge> clipped;
+        for (int k = 0; k < 3; k++)
+            clip(tri.pts[k], tri.pts[(k + 1) % 3], clipped, bounds);
+
+        if ((int) clipped.size() < 2) return;
+
+        GBandBlitter band(top, bottom, blitter);
+        walk_convex(clipped, bounds, band);
+    };
+
+    GThreadPool &pool = *fPool;
+    int band_count = (bounds.height() + kMeshBandHeight - 1) / kMeshBandHeight;
+
+    // Every band makes its own contexts from the paint's shader, unless that shader keeps one in itself (see
+    // GSingleContextShader), in which case a textured mesh is only drawn by one thread
+    bool shader_shared = texs != nullptr && !paint.getShader()->isThreadSafe();
+    if (pool.threads() == 1 || shader_shared || band_count < 2 || (int) triangles.size() < kMinParallelTriangles) {
+        for (const MeshTriangle &tri: triangles)
+            draw_triangle(tri, tri.top, tri.bottom);
+        return;
+    }
+
+    /*
+     * Bin the triangles into bands of whole device rows, in submission order. Bands never share a pixel, and each
+     * draws its triangles in the same order as a serial pass would, with the same spans (rows are only dropped,
+     * never cut), so the result is identical however the bands are spread over threads.
+     */
+    auto band_of = [&](int y) {
+        return std::max(0, std::min(band_count - 1, (y - bounds.top) / kMeshBandHeight));
+    };
+
+    std::vector<int> band_starts(band_count + 1, 0);
+    for (const MeshTriangle &tri: triangles)
+        for (int band = band_of(tri.top); band <= band_of(tri.bottom - 1); band++)
+            band_starts[band + 1]++;
+
+    std::partial_sum(band_starts.begin(), band_starts.end(), band_starts.begin());
+
+    std::vector<int> binned(band_starts.back());
+    std::vector<int> band_fill(band_starts.begin(), band_starts.end() - 1);
+    for (int i = 0; i < (int) triangles.size(); i++)
+        for (int band = band_of(triangles[i].top); band <= band_of(triangles[i].bottom - 1); band++)
+            binned[band_fill[band]++] = i;
+
+    pool.parallelFor(band_count, [&](int band) {
+        int top = bounds.top + band * kMeshBandHeight;
+        int bottom = std::min(bounds.bottom, top + kMeshBandHeight);
+
+        for (int i = band_starts[band]; i < band_starts[band + 1]; i++)
+            draw_triangle(triangles[binned[i]], top, bottom);
+    });
+}
+
+/*
+ * Fills count points, evenly spaced from a to b inclusive, stepping rather than evaluating each one.
+ */
+template<typename T>
+void lerp_row(const T &a, const T &b, int count, T *out) {
+    T step = (b - a) * (1.0f / (float) (count - 1));
+    T cur = a;
+
+    for (int j = 0; j < count - 1; j++) {
+        out[j] = cur;
+        cur += step;
+    }
+
+    out[count - 1] = b;
+}
+
+void GCanvas::drawQuad(const GPoint *verts, const GColor *colors, const GPoint *texs, int level, const GPaint &paint) {
+    if (level < 0) return;
+
+    int point_cnt = level + 2;
+    int vertex_cnt = point_cnt * point_cnt;
+
+    // The topology only depends on the level, so keep it around for the next quad drawn at the same one
+    if (fQuadLevel != level) {
+        fQuadIndices.clear();
+        fQuadIndices.reserve(6 * (point_cnt - 1) * (point_cnt - 1));
+
+        for (int i = 0; i < point_cnt - 1; i++) {
+            for (int j = 0; j < point_cnt - 1; j++) {
+                int cur_idx = i * point_cnt + j;
+
+                fQuadIndices.insert(fQuadIndices.end(), {cur_idx, cur_idx + 1, cur_idx + point_cnt,
+                                                         cur_idx + 1, cur_idx + point_cnt, cur_idx + point_cnt + 1});
+            }
+        }
+
+        fQuadLevel = level;
+    }
+
+    fQuadVerts.resize(vertex_cnt);
+    if (colors != nullptr) fQuadColors.resize(vertex_cnt);
+    if (texs != nullptr) fQuadTexs.resize(vertex_cnt);
+
+    // Each row of the lattice runs between the matching points on the left (0 -> 3) and right (1 -> 2) sides
+    float t = 0, step_size = 1.0f / (float) (level + 1);
+
+    for (int i = 0; i < point_cnt; i++, t += step_size) {
+        if (i == point_cnt - 1) t = 1;
+
+        int row = i * point_cnt;
+        lerp_row(verts[0] + (verts[3] - verts[0]) * t, verts[1] + (verts[2] - verts[1]) * t, point_cnt,
+                 fQuadVerts.data() + row);
+
+        if (colors != nullptr)
+            lerp_row(colors[0] + (colors[3] - colors[0]) * t, colors[1] + (colors[2] - colors[1]) * t, point_cnt,
+                     fQuadColors.data() + row);
+
+        if (texs != nullptr)
+            lerp_row(texs[0] + (texs[3] - texs[0]) * t, texs[1] + (texs[2] - texs[1]) * t, point_cnt,
+                     fQuadTexs.data() + row);
+    }
+
+    drawMesh(fQuadVerts.data(), colors == nullptr ? nullptr : fQuadColors.data(),
+             texs == nullptr ? nullptr : fQuadTexs.data(), (int) fQuadIndices.size() / 3, fQuadIndices.data(), paint);
+}
 
 std::unique_ptr<GCanvas> GCreateCanvas(const GBitmap &device) {
     return std::unique_ptr<GCanvas>(new GCanvas(device));
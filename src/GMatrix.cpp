@@ -96,4 +96,25 @@ void GMatrix::mapPoints(GPoint dst[], const GPoint src[], int count) const {
         dst[i] = GPoint{fMat[0] * x + fMat[2] * y + fMat[4],
                         fMat[1] * x + fMat[3] * y + fMat[5]};
     }
-}
\ No newline at end of file
+}
+
+GRect GMatrix::mapRect(const GRect &rect) const {
+    GPoint corners[4] = {{rect.left,  rect.top},
+                         {rect.right, rect.top},
+                         {rect.right, rect.bottom},
+                         {rect.left,  rect.bottom}};
+    this->mapPoints(corners, 4);
+
+    GRect mapped = GRect::LTRB(corners[0].x, corners[0].y, corners[0].x, corners[0].y);
+    for (const GPoint &p: corners) {
+        mapped.left = std::min(mapped.left, p.x);
+        mapped.top = std::min(mapped.top, p.y);
+        mapped.right = std::max(mapped.right, p.x);
+        mapped.bottom = std::max(mapped.bottom, p.y);
+    }
+    return mapped;
+}
+
+bool GMatrix::isScaleTranslate() const {
+    return fMat[1] == 0.0f && fMat[2] == 0.0f;
+}
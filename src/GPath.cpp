@@ -9,17 +9,63 @@ GPath::GPath() {}
 
 GPath::~GPath() {}
 
+GPath::GPath(const GPath &src) : fStorage(src.fStorage) {}
+
+GPath::GPath(GPath &&src) noexcept: fStorage(std::move(src.fStorage)) {}
+
 GPath &GPath::operator=(const GPath &src) {
-    if (this != &src) {
-        fPts = src.fPts;
-        fVbs = src.fVbs;
-    }
+    fStorage = src.fStorage;
+    return *this;
+}
+
+GPath &GPath::operator=(GPath &&src) noexcept {
+    fStorage = std::move(src.fStorage);
     return *this;
 }
 
 void GPath::reset() {
-    fPts.clear();
-    fVbs.clear();
+    // Keep our allocation around for reuse if nobody else is looking at it
+    if (fStorage && fStorage.use_count() == 1) {
+        fStorage->fPts.clear();
+        fStorage->fVbs.clear();
+        fStorage->fTightBounds.reset();
+        fStorage->fIsConvex.reset();
+    } else {
+        fStorage.reset();
+    }
+}
+
+void GPath::reserve(int extraPoints, int extraVerbs) {
+    Storage &storage = writable();
+    storage.fPts.reserve(storage.fPts.size() + std::max(0, extraPoints));
+    storage.fVbs.reserve(storage.fVbs.size() + std::max(0, extraVerbs));
+}
+
+static void join_point(GRect &rect, GPoint p) {
+    rect.left = std::min(rect.left, p.x);
+    rect.top = std::min(rect.top, p.y);
+    rect.right = std::max(rect.right, p.x);
+    rect.bottom = std::max(rect.bottom, p.y);
+}
+
+void GPath::Storage::addPoints(const GPoint pts[], int count) {
+    if (count <= 0) return;
+
+    if (fPts.empty())
+        fControlBounds = GRect::LTRB(pts[0].x, pts[0].y, pts[0].x, pts[0].y);
+
+    for (int i = 0; i < count; i++)
+        join_point(fControlBounds, pts[i]);
+
+    fPts.insert(fPts.end(), pts, pts + count);
+}
+
+void GPath::Storage::recomputeControlBounds() {
+    if (fPts.empty()) return;
+
+    fControlBounds = GRect::LTRB(fPts[0].x, fPts[0].y, fPts[0].x, fPts[0].y);
+    for (GPoint p: fPts)
+        join_point(fControlBounds, p);
 }
 
 void GPath::dump() const {
@@ -47,26 +93,27 @@ void GPath::dump() const {
 }
 
 void GPath::quadTo(GPoint p1, GPoint p2) {
-    assert(fVbs.size() > 0);
-    fPts.push_back(p1);
-    fPts.push_back(p2);
-    fVbs.push_back(kQuad);
+    assert(countVerbs() > 0);
+    Storage &storage = writable();
+    GPoint pts[] = {p1, p2};
+    storage.addPoints(pts, 2);
+    storage.fVbs.push_back(kQuad);
 }
 
 void GPath::cubicTo(GPoint p1, GPoint p2, GPoint p3) {
-    assert(fVbs.size() > 0);
-    fPts.push_back(p1);
-    fPts.push_back(p2);
-    fPts.push_back(p3);
-    fVbs.push_back(kCubic);
+    assert(countVerbs() > 0);
+    Storage &storage = writable();
+    GPoint pts[] = {p1, p2, p3};
+    storage.addPoints(pts, 3);
+    storage.fVbs.push_back(kCubic);
 }
 
 /////////////////////////////////////////////////////////////////
 
 GPath::Iter::Iter(const GPath &path) {
-    fCurrPt = path.fPts.data();
-    fCurrVb = path.fVbs.data();
-    fStopVb = fCurrVb + path.fVbs.size();
+    fCurrPt = path.pointsData();
+    fCurrVb = path.verbsData();
+    fStopVb = fCurrVb + path.countVerbs();
 }
 
 std::optional<GPath::Verb> GPath::Iter::next(GPoint pts[]) {
@@ -102,13 +149,26 @@ constexpr int kDoneVerb = -1;
 
 GPath::Edger::Edger(const GPath &path) {
     fPrevMove = nullptr;
-    fCurrPt = path.fPts.data();
-    fCurrVb = path.fVbs.data();
-    fStopVb = fCurrVb + path.fVbs.size();
+    fCurrPt = path.pointsData();
+    fCurrVb = path.verbsData();
+    fStopVb = fCurrVb + path.countVerbs();
     fPrevVerb = kDoneVerb;
 }
 
+GPath::Edger::Edger(const GPath &path, const GMatrix &matrix) : Edger(path) {
+    fMatrix = matrix;
+}
+
 std::optional<GPath::Verb> GPath::Edger::next(GPoint pts[]) {
+    auto verb = nextEdge(pts);
+
+    if (verb.has_value() && fMatrix.has_value())
+        fMatrix->mapPoints(pts, verb.value() + 1);
+
+    return verb;
+}
+
+std::optional<GPath::Verb> GPath::Edger::nextEdge(GPoint pts[]) {
     assert(fCurrVb <= fStopVb);
     bool do_return = false;
     while (fCurrVb < fStopVb) {
@@ -173,10 +233,12 @@ void GPath::addRect(const GRect &rect, Direction dir) {
 }
 
 void GPath::addPolygon(const GPoint *pts, int count) {
-    moveTo(pts[0]);
+    if (count < 1) return;
 
-    for (int i = 1; i < count; i++)
-        lineTo(pts[i]);
+    Storage &storage = writable();
+    storage.addPoints(pts, count);
+    storage.fVbs.push_back(kMove);
+    storage.fVbs.insert(storage.fVbs.end(), count - 1, kLine);
 }
 
 void GPath::addCircle(GPoint center, float radius, GPath::Direction direction) {
@@ -228,108 +290,175 @@ void GPath::addCircle(GPoint center, float radius, GPath::Direction direction) {
 }
 
 GRect GPath::bounds() const {
-    int num_points = countPoints();
+    if (countPoints() == 0)
+        return GRect::LTRB(0.0f, 0.0f, 0.0f, 0.0f);
+
+    return fStorage->fTightBounds.get([this]() { return computeTightBounds(); });
+}
 
-    if (num_points == 0)
+GRect GPath::controlBounds() const {
+    if (countPoints() == 0)
         return GRect::LTRB(0.0f, 0.0f, 0.0f, 0.0f);
 
-    std::pair<float, float> x_bounds = std::make_pair(10000, -10000); // {left, right}
-    std::pair<float, float> y_bounds = std::make_pair(10000, -10000); // {top, bottom}
+    return fStorage->fControlBounds;
+}
+
+GRect GPath::computeTightBounds() const {
+    GPoint first = pointsData()[0];
+    GRect computed_bounds = GRect::LTRB(first.x, first.y, first.x, first.y);
+
+    auto extend = [&](GPoint p) { join_point(computed_bounds, p); };
+
+    // Only extrema strictly inside the segment matter, the end points are added separately
+    auto in_segment = [](float t) { return t > 0.0f && t < 1.0f; };
 
     Edger edger(*this);
     GPoint points[GPath::kMaxNextPoints];
 
-    while (const auto verb = edger.next(points))
-        if (verb.value() == kLine) {
-            x_bounds.first = std::min(x_bounds.first, points[0].x);
-            x_bounds.second = std::max(x_bounds.second, points[0].x);
-            x_bounds.first = std::min(x_bounds.first, points[1].x);
-            x_bounds.second = std::max(x_bounds.second, points[1].x);
-
-            y_bounds.first = std::min(y_bounds.first, points[0].y);
-            y_bounds.second = std::max(y_bounds.second, points[0].y);
-            y_bounds.first = std::min(y_bounds.first, points[1].y);
-            y_bounds.second = std::max(y_bounds.second, points[1].y);
-        } else if (verb.value() == kQuad) {
+    while (const auto verb = edger.next(points)) {
+        extend(points[0]);
+        extend(points[verb.value()]);
+
+        if (verb.value() == kQuad) {
             float dx = bezier::derivative_zero_quad(points[0].x, points[1].x, points[2].x);
             float dy = bezier::derivative_zero_quad(points[0].y, points[1].y, points[2].y);
 
-            if (dx != -1.0) {
-                GPoint x_eval = bezier::eval_quad(dx, points);
-                x_bounds.first = std::min(x_bounds.first, x_eval.x);
-                x_bounds.second = std::max(x_bounds.second, x_eval.x);
-            }
+            if (in_segment(dx)) extend(bezier::eval_quad(dx, points));
+            if (in_segment(dy)) extend(bezier::eval_quad(dy, points));
+        } else if (verb.value() == kCubic) {
+            auto dx = bezier::derivative_zero_cubic(points[0].x, points[1].x, points[2].x, points[3].x);
+            auto dy = bezier::derivative_zero_cubic(points[0].y, points[1].y, points[2].y, points[3].y);
 
-            if (dy != -1.0) {
-                GPoint y_eval = bezier::eval_quad(dy, points);
-                y_bounds.first = std::min(y_bounds.first, y_eval.y);
-                y_bounds.second = std::max(y_bounds.second, y_eval.y);
-            }
+            for (float t: {dx.first, dx.second, dy.first, dy.second})
+                if (in_segment(t)) extend(bezier::eval_cubic(t, points));
+        }
+    }
 
-            x_bounds.first = std::min(x_bounds.first, points[0].x);
-            x_bounds.second = std::max(x_bounds.second, points[0].x);
-            x_bounds.first = std::min(x_bounds.first, points[2].x);
-            x_bounds.second = std::max(x_bounds.second, points[2].x);
+    return computed_bounds;
+}
 
-            y_bounds.first = std::min(y_bounds.first, points[0].y);
-            y_bounds.second = std::max(y_bounds.second, points[0].y);
-            y_bounds.first = std::min(y_bounds.first, points[2].y);
-            y_bounds.second = std::max(y_bounds.second, points[2].y);
+bool GPath::isConvex() const {
+    if (countPoints() == 0)
+        return false;
 
-        } else if (verb.value() == kCubic) {
-            std::pair<float, float> dx = bezier::derivative_zero_cubic(points[0].x, points[1].x, points[2].x,
-                                                                       points[3].x);
-            std::pair<float, float> dy = bezier::derivative_zero_cubic(points[0].y, points[1].y, points[2].y,
-                                                                       points[3].y);
+    return fStorage->fIsConvex.get([this]() { return computeIsConvex(); });
+}
 
-            if (dx.first + 1.0f > 0.000000001) {
-                GPoint x_eval1 = bezier::eval_cubic(dx.first, points);
-                x_bounds.first = std::min(x_bounds.first, x_eval1.x);
-                x_bounds.second = std::max(x_bounds.second, x_eval1.x);
+bool GPath::computeIsConvex() const {
+    const Verb *verbs = verbsData();
+    int num_verbs = countVerbs();
 
-                GPoint x_eval2 = bezier::eval_cubic(dx.second, points);
-                x_bounds.first = std::min(x_bounds.first, x_eval2.x);
-                x_bounds.second = std::max(x_bounds.second, x_eval2.x);
+    // Exactly one contour
+    for (int i = 1; i < num_verbs; i++)
+        if (verbs[i] == kMove)
+            return false;
 
-//                printf("x_eval: %f %f\n", x_eval1.x, x_eval2.x);
-            }
+    // Walk the closed polygon through every point, control points included. It is convex if it always turns the same
+    // way, and its direction flips at most twice in x and twice in y (which rules out contours winding around twice).
+    const GPoint *pts = pointsData();
+    int num_points = countPoints();
 
-            if (dy.first + 1.0f > 0.000000001f) {
-                GPoint y_eval1 = bezier::eval_cubic(dy.first, points);
-                y_bounds.first = std::min(y_bounds.first, y_eval1.y);
-                y_bounds.second = std::max(y_bounds.second, y_eval1.y);
+    std::vector<GVector> vecs;
+    vecs.reserve(num_points);
+    for (int i = 0; i < num_points; i++) {
+        GVector vec = pts[(i + 1) % num_points] - pts[i];
+        if (vec.x != 0 || vec.y != 0)
+            vecs.push_back(vec);
+    }
 
-                GPoint y_eval2 = bezier::eval_cubic(dy.second, points);
-                y_bounds.first = std::min(y_bounds.first, y_eval2.y);
-                y_bounds.second = std::max(y_bounds.second, y_eval2.y);
+    auto sign = [](float v) { return (v > 0) - (v < 0); };
 
-//                printf("y_eval: %f %f\n", y_eval1.y, y_eval2.y);
-            }
+    int num_vecs = (int) vecs.size();
+    int turn = 0, x_flips = 0, y_flips = 0, x_sign = 0, y_sign = 0;
 
+    // The second lap wraps the comparisons around from the last edge to the first
+    for (int i = 0; i < 2 * num_vecs; i++) {
+        const GVector &cur = vecs[i % num_vecs];
 
-            x_bounds.first = std::min(x_bounds.first, points[0].x);
-            x_bounds.first = std::min(x_bounds.first, points[2].x);
-            x_bounds.second = std::max(x_bounds.second, points[0].x);
-            x_bounds.second = std::max(x_bounds.second, points[2].x);
+        if (i > 0) {
+            const GVector &prev = vecs[(i - 1) % num_vecs];
+            int cross = sign(prev.x * cur.y - prev.y * cur.x);
 
-//            printf("x_control_eval: %f %f\n", points[0].x, points[3].x);
+            if (cross != 0) {
+                if (turn != 0 && cross != turn) return false;
+                turn = cross;
+            }
+        }
 
-            y_bounds.first = std::min(y_bounds.first, points[0].y);
-            y_bounds.first = std::min(y_bounds.first, points[2].y);
-            y_bounds.second = std::max(y_bounds.second, points[0].y);
-            y_bounds.second = std::max(y_bounds.second, points[2].y);
+        // Flips are only counted on the second lap, where the first comparison wraps around to the last edge
+        bool counting = i >= num_vecs;
+        int sx = sign(cur.x), sy = sign(cur.y);
+
+        if (sx != 0) {
+            x_flips += counting && x_sign != 0 && sx != x_sign;
+            x_sign = sx;
+        }
+        if (sy != 0) {
+            y_flips += counting && y_sign != 0 && sy != y_sign;
+            y_sign = sy;
         }
+    }
 
-    auto computed_bounds = GRect::LTRB(x_bounds.first, y_bounds.first, x_bounds.second, y_bounds.second);
-//    printf("%f %f %f %f", bou.left, bou.top, bou.right, bou.bottom);
-    return computed_bounds;
+    return x_flips <= 2 && y_flips <= 2;
 }
 
-void GPath::transform(const GMatrix &transformer) {
+bool GPath::isRect(GRect *rect, Direction *direction) const {
     int num_points = countPoints();
+    if (num_points != 4 && num_points != 5)
+        return false;
+
+    const Verb *verbs = verbsData();
+    for (int i = 1; i < num_points; i++)
+        if (verbs[i] != kLine)
+            return false;
+
+    const GPoint *pts = pointsData();
+    if (num_points == 5 && (pts[4].x != pts[0].x || pts[4].y != pts[0].y))
+        return false;
+
+    // The sides alternate between horizontal and vertical, starting with either
+    bool horizontal_first = pts[0].y == pts[1].y;
+    for (int i = 0; i < 4; i++) {
+        GPoint p0 = pts[i], p1 = pts[(i + 1) % 4];
+        bool horizontal = (i % 2 == 0) == horizontal_first;
+
+        if (horizontal ? p0.y != p1.y : p0.x != p1.x)
+            return false;
+    }
+
+    GRect found = GRect::LTRB(std::min(pts[0].x, pts[2].x), std::min(pts[0].y, pts[2].y),
+                              std::max(pts[0].x, pts[2].x), std::max(pts[0].y, pts[2].y));
+    if (found.isEmpty())
+        return false;
+
+    if (rect != nullptr)
+        *rect = found;
+
+    if (direction != nullptr) {
+        GVector e0 = pts[1] - pts[0], e1 = pts[2] - pts[1];
+        *direction = e0.x * e1.y - e0.y * e1.x > 0 ? kCW_Direction : kCCW_Direction;
+    }
+
+    return true;
+}
+
+void GPath::transform(const GMatrix &transformer) {
+    if (countPoints() == 0) return;
+
+    if (fStorage.use_count() > 1) {
+        // Shared: map straight into a fresh block instead of copying and then mapping in place
+        auto storage = std::make_shared<Storage>();
+        storage->fVbs = fStorage->fVbs;
+        storage->fPts.resize(fStorage->fPts.size());
+        transformer.mapPoints(storage->fPts.data(), fStorage->fPts.data(), countPoints());
+        storage->recomputeControlBounds();
+        fStorage = std::move(storage);
+        return;
+    }
 
-    for (int i = 0; i < num_points; i++)
-        fPts[i] = transformer * fPts[i];
+    Storage &storage = writable();
+    transformer.mapPoints(storage.fPts.data(), countPoints());
+    storage.recomputeControlBounds();
 }
 
 void GPath::ChopQuadAt(const GPoint src[3], GPoint dst[5], float t) {
@@ -0,0 +1,176 @@
+/*
+ *  Copyright 2024 Aruj Bansal
+ */
+
+#include "../include/GRegion.h"
+
+#include <algorithm>
+
+GRegion::GRegion() : fBounds(GIRect::LTRB(0, 0, 0, 0)) {}
+
+GRegion::GRegion(const GIRect &rect) : GRegion() {
+    if (rect.isEmpty()) return;
+
+    fBounds = rect;
+    fSpans.assign(rect.height(), {rect.left, rect.right});
+    fRows.resize(rect.height() + 1);
+    for (int i = 0; i <= rect.height(); i++)
+        fRows[i] = i;
+}
+
+bool GRegion::isRect() const {
+    if (isEmpty()) return true;
+
+    for (int y = fBounds.top; y < fBounds.bottom; y++) {
+        if (rowEnd(y) - rowBegin(y) != 1) return false;
+
+        const Span &span = *rowBegin(y);
+        if (span.left != fBounds.left || span.right != fBounds.right) return false;
+    }
+
+    return true;
+}
+
+bool GRegion::contains(int x, int y) const {
+    for (const Span *span = rowBegin(y); span != rowEnd(y); span++)
+        if (x >= span->left && x < span->right)
+            return true;
+
+    return false;
+}
+
+void GRegion::addRow(int y, const std::vector<Span> &spans) {
+    if (spans.empty()) return;
+
+    fRowYs.push_back(y);
+    fRows.push_back((int) fSpans.size());
+    fSpans.insert(fSpans.end(), spans.begin(), spans.end());
+}
+
+void GRegion::finish() {
+    if (fRowYs.empty()) {
+        *this = GRegion();
+        return;
+    }
+
+    int top = fRowYs.front(), bottom = fRowYs.back() + 1;
+    int left = fSpans.front().left, right = fSpans.front().right;
+    for (const Span &span: fSpans) {
+        left = std::min(left, span.left);
+        right = std::max(right, span.right);
+    }
+
+    // Expand the rows that were added into a table with an entry for every row, empty ones included
+    std::vector<int> rows(bottom - top + 1);
+    int added = 0;
+    for (int y = top; y <= bottom; y++) {
+        while (added < (int) fRowYs.size() && fRowYs[added] < y) added++;
+        rows[y - top] = added < (int) fRowYs.size() ? fRows[added] : (int) fSpans.size();
+    }
+
+    fBounds = GIRect::LTRB(left, top, right, bottom);
+    fRows = std::move(rows);
+    fRowYs.clear();
+    fRowYs.shrink_to_fit();
+}
+
+template<typename RowOp>
+GRegion GRegion::Combine(const GRegion &a, const GRegion &b, int top, int bottom, RowOp &&op) {
+    GRegion result;
+    std::vector<Span> row;
+
+    for (int y = top; y < bottom; y++) {
+        row.clear();
+        op(a.rowBegin(y), a.rowEnd(y), b.rowBegin(y), b.rowEnd(y), row);
+        result.addRow(y, row);
+    }
+
+    result.finish();
+    return result;
+}
+
+GRegion GRegion::intersect(const GRegion &other) const {
+    int top = std::max(fBounds.top, other.fBounds.top);
+    int bottom = std::min(fBounds.bottom, other.fBounds.bottom);
+
+    auto intersect_row = [](const Span *a, const Span *a_end, const Span *b, const Span *b_end,
+                            std::vector<Span> &out) {
+        while (a != a_end && b != b_end) {
+            int left = std::max(a->left, b->left), right = std::min(a->right, b->right);
+            if (left < right) out.push_back({left, right});
+
+            // Whichever span ends first can't overlap anything further along the other row
+            if (a->right < b->right) a++;
+            else b++;
+        }
+    };
+
+    return Combine(*this, other, top, bottom, intersect_row);
+}
+
+GRegion GRegion::unite(const GRegion &other) const {
+    if (isEmpty()) return other;
+    if (other.isEmpty()) return *this;
+
+    int top = std::min(fBounds.top, other.fBounds.top);
+    int bottom = std::max(fBounds.bottom, other.fBounds.bottom);
+
+    auto unite_row = [](const Span *a, const Span *a_end, const Span *b, const Span *b_end,
+                        std::vector<Span> &out) {
+        while (a != a_end || b != b_end) {
+            // Take the span that starts first, merging it into the last one if they touch
+            const Span *next = b == b_end || (a != a_end && a->left <= b->left) ? a++ : b++;
+
+            if (!out.empty() && next->left <= out.back().right)
+                out.back().right = std::max(out.back().right, next->right);
+            else
+                out.push_back(*next);
+        }
+    };
+
+    return Combine(*this, other, top, bottom, unite_row);
+}
+
+void GRegion::Builder::blitH(int x, int y, int w) {
+    fRowSpans.push_back({y, x, x + w});
+}
+
+GRegion GRegion::Builder::detach() {
+    std::sort(fRowSpans.begin(), fRowSpans.end(), [](const RowSpan &a, const RowSpan &b) {
+        return a.y < b.y || (a.y == b.y && a.left < b.left);
+    });
+
+    GRegion region;
+    std::vector<Span> row;
+
+    for (size_t i = 0; i < fRowSpans.size();) {
+        int y = fRowSpans[i].y;
+        row.clear();
+
+        for (; i < fRowSpans.size() && fRowSpans[i].y == y; i++) {
+            const RowSpan &span = fRowSpans[i];
+
+            if (!row.empty() && span.left <= row.back().right)
+                row.back().right = std::max(row.back().right, span.right);
+            else
+                row.push_back({span.left, span.right});
+        }
+
+        region.addRow(y, row);
+    }
+
+    fRowSpans.clear();
+    region.finish();
+    return region;
+}
+
+void GRegionBlitter::blitH(int x, int y, int w) {
+    int right = x + w;
+
+    for (const GRegion::Span *span = fRegion.rowBegin(y); span != fRegion.rowEnd(y); span++) {
+        if (span->left >= right) break;
+
+        int l = std::max(x, span->left), r = std::min(right, span->right);
+        if (l < r) fNext->blitH(l, y, r - l);
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ *  Copyright 2024 Aruj Bansal
+ */
+
+#include "../include/GThreadPool.h"
+
+#include <algorithm>
+
+GThreadPool::GThreadPool(int count) {
+    for (int i = 0; i < count; i++) {
+        fWorkers.emplace_back([this] {
+            uint64_t seen = 0;
+
+            for (;;) {
+                // The job is copied out under the lock, so the next parallelFor is free to replace it
+                const std::function<void(int)> *job;
+                int count;
+                {
+                    std::unique_lock<std::mutex> lock(fMutex);
+                    fWake.wait(lock, [&] { return fQuit || fGeneration != seen; });
+
+                    if (fQuit) return;
+                    seen = fGeneration;
+                    job = fJob;
+                    count = fCount;
+                    fBusy++;
+                }
+
+                work(*job, count);
+
+                std::lock_guard<std::mutex> lock(fMutex);
+                if (--fBusy == 0) fDone.notify_all();
+            }
+        });
+    }
+}
+
+GThreadPool::~GThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fQuit = true;
+    }
+
+    fWake.notify_all();
+    for (std::thread &worker: fWorkers)
+        worker.join();
+}
+
+GThreadPool &GThreadPool::Default() {
+    static GThreadPool pool(std::max(0, (int) std::thread::hardware_concurrency() - 1));
+    return pool;
+}
+
+void GThreadPool::work(const std::function<void(int)> &job, int count) {
+    for (int i = fNext++; i < count; i = fNext++)
+        job(i);
+}
+
+void GThreadPool::parallelFor(int count, const std::function<void(int)> &fn) {
+    if (count <= 0) return;
+
+    if (fWorkers.empty() || count == 1) {
+        for (int i = 0; i < count; i++)
+            fn(i);
+        return;
+    }
+
+    std::lock_guard<std::mutex> job_lock(fJobMutex);
+
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fJob = &fn;
+        fCount = count;
+        fNext = 0;
+        fGeneration++;
+    }
+
+    fWake.notify_all();
+    work(fn, count);
+
+    // Workers that woke late find nothing left to claim, but the job has to outlive every one that is still in it
+    std::unique_lock<std::mutex> lock(fMutex);
+    fDone.wait(lock, [&] { return fBusy == 0; });
+    fJob = nullptr;
+}
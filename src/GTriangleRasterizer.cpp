@@ -0,0 +1,150 @@
+/*
+ *  Copyright 2024 Aruj Bansal
+ */
+
+#include "../include/GTriangleRasterizer.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+    enum {
+        // Corners are snapped to 1/256 of a pixel
+        kSubBits = 8,
+        kSubOne = 1 << kSubBits,
+        kBlock = 8,
+    };
+
+    // Corners beyond this many pixels from the origin could overflow the 64 bit edge functions
+    constexpr float kMaxCoord = (float) (1 << 20);
+
+    /*
+     * E(x, y) = a * x + b * y + c in subpixel units, positive inside the triangle. bias is 0 for top and left
+     * edges and -1 otherwise, so a pixel center is inside exactly when E + bias >= 0.
+     */
+    struct EdgeFunction {
+        int64_t a, b, c;
+        int64_t bias;
+
+        // The value at the center of pixel (x, y)
+        int64_t at(int x, int y) const {
+            return a * ((int64_t) x * kSubOne + kSubOne / 2) + b * ((int64_t) y * kSubOne + kSubOne / 2) + c + bias;
+        }
+    };
+
+    EdgeFunction make_edge(int64_t x0, int64_t y0, int64_t x1, int64_t y1) {
+        EdgeFunction e;
+        e.a = y0 - y1;
+        e.b = x1 - x0;
+        e.c = x0 * y1 - x1 * y0;
+
+        // Inside lies to the right of a left edge, and below a top (horizontal) edge
+        bool top_left = e.a > 0 || (e.a == 0 && e.b > 0);
+        e.bias = top_left ? 0 : -1;
+        return e;
+    }
+}
+
+bool GRasterizeTriangle(const GPoint pts[3], const GIRect &bounds, GBlitter &blitter) {
+    for (int k = 0; k < 3; k++)
+        if (!(std::abs(pts[k].x) < kMaxCoord && std::abs(pts[k].y) < kMaxCoord)) return false;
+
+    int64_t xs[3], ys[3];
+    for (int k = 0; k < 3; k++) {
+        xs[k] = (int64_t) std::lround(pts[k].x * kSubOne);
+        ys[k] = (int64_t) std::lround(pts[k].y * kSubOne);
+    }
+
+    // Twice the signed area; wind the edges so that the inside is positive
+    int64_t area = (xs[1] - xs[0]) * (ys[2] - ys[0]) - (xs[2] - xs[0]) * (ys[1] - ys[0]);
+    if (area == 0) return true;
+    if (area < 0) {
+        std::swap(xs[1], xs[2]);
+        std::swap(ys[1], ys[2]);
+    }
+
+    const EdgeFunction edges[3] = {make_edge(xs[1], ys[1], xs[2], ys[2]),
+                                   make_edge(xs[2], ys[2], xs[0], ys[0]),
+                                   make_edge(xs[0], ys[0], xs[1], ys[1])};
+
+    // Pixels whose centers may be inside, clipped to the bounds
+    auto first_center = [](int64_t v) { return (int) ((v - kSubOne / 2 + kSubOne - 1) >> kSubBits); };
+    auto last_center = [](int64_t v) { return (int) ((v - kSubOne / 2) >> kSubBits); };
+
+    int left = std::max(bounds.left, first_center(*std::min_element(xs, xs + 3)));
+    int top = std::max(bounds.top, first_center(*std::min_element(ys, ys + 3)));
+    int right = std::min(bounds.right, last_center(*std::max_element(xs, xs + 3)) + 1);
+    int bottom = std::min(bounds.bottom, last_center(*std::max_element(ys, ys + 3)) + 1);
+    if (left >= right || top >= bottom) return true;
+
+    // Each block row is gathered into one [left, right) span per pixel row, since a triangle's rows are contiguous
+    int span_left[kBlock], span_right[kBlock];
+
+    for (int by = top; by < bottom; by += kBlock) {
+        int rows = std::min((int) kBlock, bottom - by);
+        std::fill(span_left, span_left + rows, INT_MAX);
+        std::fill(span_right, span_right + rows, INT_MIN);
+
+        for (int bx = left; bx < right; bx += kBlock) {
+            int cols = std::min((int) kBlock, right - bx);
+
+            bool all_inside = true, all_outside = false;
+            int64_t e0[3];
+
+            for (int k = 0; k < 3; k++) {
+                const EdgeFunction &e = edges[k];
+                e0[k] = e.at(bx, by);
+
+                // The function is linear, so its extremes over the block's centers are at the corners
+                int64_t dx = e.a * kSubOne * (cols - 1), dy = e.b * kSubOne * (rows - 1);
+                int64_t lo = e0[k] + std::min<int64_t>(0, dx) + std::min<int64_t>(0, dy);
+                int64_t hi = e0[k] + std::max<int64_t>(0, dx) + std::max<int64_t>(0, dy);
+
+                all_outside |= hi < 0;
+                all_inside &= lo >= 0;
+            }
+
+            if (all_outside) continue;
+
+            if (all_inside) {
+                for (int r = 0; r < rows; r++) {
+                    span_left[r] = std::min(span_left[r], bx);
+                    span_right[r] = std::max(span_right[r], bx + cols);
+                }
+                continue;
+            }
+
+            // Partial block: test every center, a row of the block at a time
+            for (int r = 0; r < rows; r++) {
+                uint32_t mask = 0;
+
+                for (int c = 0; c < cols; c++) {
+                    bool inside = true;
+                    for (int k = 0; k < 3; k++)
+                        inside &= e0[k] + edges[k].a * kSubOne * c >= 0;
+                    mask |= (uint32_t) inside << c;
+                }
+
+                for (int k = 0; k < 3; k++)
+                    e0[k] += edges[k].b * kSubOne;
+
+                if (mask == 0) continue;
+
+                span_left[r] = std::min(span_left[r], bx + __builtin_ctz(mask));
+                span_right[r] = std::max(span_right[r], bx + 32 - __builtin_clz(mask));
+            }
+        }
+
+        GSpan spans[kBlock];
+        int count = 0;
+        for (int r = 0; r < rows; r++)
+            if (span_left[r] < span_right[r])
+                spans[count++] = {span_left[r], by + r, span_right[r] - span_left[r]};
+
+        if (count > 0) blitter.blitSpans(spans, count);
+    }
+
+    return true;
+}